@@ -6,32 +6,164 @@
 #include <stdexcept>
 #include <array>
 #include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+#ifdef VKE_EMBEDDED_SHADERS
+// generated by embed_spirv.cmake at build time
+#include "simple_shader_vert.hpp"
+#include "simple_shader_frag.hpp"
+#endif
+
+// Set by CMake for hot reload builds: the GLSL sources to watch & how to compile them
+#ifndef VKE_GLSL_COMPILER
+#define VKE_GLSL_COMPILER "glslc"
+#endif
+
 namespace vke {
 
 	// Constructor Imp.
-	VkeApplication::VkeApplication() {
-		loadModels();
+	// The window has to exist before the device member is initialized, so it's created here rather than in the body
+	VkeApplication::VkeApplication(const VkeApplicationOptions& options)
+		: options{ options },
+		  vkeWindow{ options.headless ? nullptr : std::make_unique<VkeWindow>(WIDTH, HEIGHT, "VK Window...") } {
+		if (options.headless) {
+			offscreenRing = std::make_unique<VkeOffscreenRing>(vkDerkDevice, VkExtent2D{ WIDTH, HEIGHT });
+			renderTarget = offscreenRing.get();
+		}
+		else {
+			vkeSwapChain = std::make_unique<VkeSwapChain>(vkDerkDevice, vkeWindow->getExtent(), options.presentPolicy);
+			renderTarget = vkeSwapChain.get();
+		}
+
+		loadShaders();
 		createPipelineLayout();
-		createPipeline();
+		createPipeline();		// queued: compiles on the builder's workers while the models load
+		loadModels();
 		createCommandBuffers();
+		vkePipeline = pendingPipeline.get().get();	// rethrows if the build failed
+		if (!options.headless) {
+			startShaderHotReload();
+		}
 	}
 
 	// Destructor Imp.
 	VkeApplication::~VkeApplication() {
-		vkDestroyPipelineLayout(vkDerkDevice.device(), pipelineLayout, nullptr);
-		createPipeline();
-		createCommandBuffers();
+		// pipeline layout belongs to the device's layout cache, pipelines to the registry
 	}
 
 	void VkeApplication::vke_app_run() {
+		if (options.headless) {
+			if (options.benchmarkVertexFetch) {
+				runVertexFetchBenchmark();
+			}
+			else {
+				runHeadless();
+			}
+			return;
+		}
+
+		auto lastStatsDump = std::chrono::steady_clock::now();
+		auto lastCacheSave = lastStatsDump;
 
 		// While 
-		while (!vkeWindow.shouldClose()) {
+		while (!vkeWindow->shouldClose()) {
 			glfwPollEvents();
+			pollShaderHotReload();	// frame boundary: the only place the pipeline may change
+			pollPresentPolicyKeys();	// ...or the swap chain
 			drawFrame();
+
+			// Periodic memory report: for sizing pools and spotting leaks under load
+			if (options.memoryStatsInterval > 0.0) {
+				auto now = std::chrono::steady_clock::now();
+				if (std::chrono::duration<double>(now - lastStatsDump).count() >= options.memoryStatsInterval) {
+					vkDerkDevice.dumpMemoryStats(std::cout);
+					lastStatsDump = now;
+				}
+			}
+
+			// Periodic pipeline cache save (no-op when nothing new was compiled), the device saves once more on shutdown
+			auto now = std::chrono::steady_clock::now();
+			if (std::chrono::duration<double>(now - lastCacheSave).count() >= PIPELINE_CACHE_SAVE_INTERVAL) {
+				vkDerkDevice.pipelineCache().save();
+				lastCacheSave = now;
+			}
+		}
+
+		vkDeviceWaitIdle(vkDerkDevice.device());
+	}
+
+	// Same drawFrame as the window, minus events, hot reload & present policy keys. No vsync: the offscreen ring only
+	// waits for the frame that last used the slot, so the CPU runs at most MAX_FRAMES_IN_FLIGHT frames ahead
+	void VkeApplication::runHeadless() {
+		double seconds = timeHeadlessFrames(options.headlessFrames);
+		std::cout << "headless: " << options.headlessFrames << " frames in " << seconds << " s";
+		if (seconds > 0.0) {
+			std::cout << " (" << options.headlessFrames / seconds << " fps)";
+		}
+		std::cout << std::endl;
+		if (options.memoryStatsInterval > 0.0) {
+			vkDerkDevice.dumpMemoryStats(std::cout);	// once, after the run: headless has no wall clock worth sampling by
 		}
+	}
+
+	// Seconds from the first drawFrame until the GPU finished the last one
+	double VkeApplication::timeHeadlessFrames(uint32_t frames) {
+
+		// Every frame should draw the model, so the timing doesn't include frames that skipped it while it uploaded
+		vkDerkDevice.uploader().wait(vkDerkDevice.uploader().flush());
 
+		auto start = std::chrono::steady_clock::now();
+		for (uint32_t frame = 0; frame < frames; frame++) {
+			drawFrame();
+		}
 		vkDeviceWaitIdle(vkDerkDevice.device());
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// Vertex fetch benchmark: the same grid of tiny triangles as a standalone model in each memory policy. The fragment
+	// shader is trivial and most triangles cover no pixel, so the frame time is mostly vertex fetch & transform.
+	// Discrete GPUs should show the PCIe reads of HostVisible; integrated GPUs and lavapipe, where all memory is
+	// system memory, should show about the same time for both
+	void VkeApplication::runVertexFetchBenchmark() {
+		std::vector<VkeModel::Vertex> vertices;
+		std::vector<uint32_t> indices;
+		const uint32_t side = BENCHMARK_GRID_CELLS + 1;	// vertices per row
+		vertices.reserve(side * side);
+		for (uint32_t y = 0; y < side; y++) {
+			for (uint32_t x = 0; x < side; x++) {
+				float u = static_cast<float>(x) / BENCHMARK_GRID_CELLS;
+				float v = static_cast<float>(y) / BENCHMARK_GRID_CELLS;
+				vertices.push_back({ { u * 1.8f - 0.9f, v * 1.8f - 0.9f } });
+			}
+		}
+		indices.reserve(BENCHMARK_GRID_CELLS * BENCHMARK_GRID_CELLS * 6);
+		for (uint32_t y = 0; y < BENCHMARK_GRID_CELLS; y++) {
+			for (uint32_t x = 0; x < BENCHMARK_GRID_CELLS; x++) {
+				uint32_t topLeft = y * side + x;
+				uint32_t bottomLeft = topLeft + side;
+				// same winding as the triangle in loadModels
+				indices.insert(indices.end(), { topLeft, bottomLeft + 1, bottomLeft, topLeft, topLeft + 1, bottomLeft + 1 });
+			}
+		}
+
+		static const std::pair<const char*, VkeModel::MemoryPolicy> policies[] = {
+			{ "host-visible", VkeModel::MemoryPolicy::HostVisible },
+			{ "device-local", VkeModel::MemoryPolicy::DeviceLocal },
+		};
+		std::cout << "vertex fetch: " << vertices.size() << " vertices, " << indices.size() << " indices, "
+			<< options.headlessFrames << " frames per policy" << std::endl;
+		for (const auto& policy : policies) {
+			vkeModel = std::make_unique<VkeModel>(vkDerkDevice, vertices, indices, policy.second);	// nothing in flight: no frame yet, or the last run ended idle
+			drawFrame();	// warm up: first use of the buffers & pipeline
+			double seconds = timeHeadlessFrames(options.headlessFrames);
+			std::cout << "  " << policy.first << ": " << seconds << " s";
+			if (options.headlessFrames > 0) {
+				std::cout << " (" << seconds * 1000.0 / options.headlessFrames << " ms/frame)";
+			}
+			std::cout << std::endl;
+		}
 	}
 
 	void VkeApplication::loadModels() {
@@ -41,40 +173,129 @@ namespace vke {
 			{{-0.5f, 0.5f}}
 		};
 
-		vkeModel = std::make_unique<VkeModel>(vkDerkDevice, vertices);
+		vkeModel = std::make_unique<VkeModel>(meshPool, vertices);
+		vkDerkDevice.uploader().flush();	// kick off any staged uploads, models become drawable once they land
 	}
 
-	void VkeApplication::createPipelineLayout() {
+	void VkeApplication::loadShaders() {
+#ifdef VKE_EMBEDDED_SHADERS
+		vertShader = vkDerkDevice.shaderRegistry().get(VkeSpirvSpan{ shaders::simple_shader_vert });
+		fragShader = vkDerkDevice.shaderRegistry().get(VkeSpirvSpan{ shaders::simple_shader_frag });
+#else
+		vertShader = vkDerkDevice.shaderRegistry().load("simple_shader.vert.spv");
+		fragShader = vkDerkDevice.shaderRegistry().load("simple_shader.frag.spv");
+#endif
+	}
 
-		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-		pipelineLayoutInfo.setLayoutCount = 0;
-		pipelineLayoutInfo.pSetLayouts = nullptr;
-		pipelineLayoutInfo.pushConstantRangeCount = 0;
-		pipelineLayoutInfo.pPushConstantRanges = nullptr;
+	void VkeApplication::createPipelineLayout() {
 
-		if (vkCreatePipelineLayout(vkDerkDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
-			throw std::runtime_error("failed to create pipeline layout!");
-		}
+		// Descriptor sets & push constants as the shaders declare them (reflected from the SPIR-V), merged over both stages.
+		// Adding a uniform or push constant block to a shader needs no change here
+		VkePipelineLayoutDescription layoutDescription = VkePipelineLayoutDescription::merge({ &vertShader->reflection(), &fragShader->reflection() });
+		pipelineLayout = vkDerkDevice.pipelineLayoutCache().get(layoutDescription);
 	}
 
 	void VkeApplication::createPipeline() {
 
-		PipelineConfigInfo pipelineConfig{};
-		VkePipeline::defaultPipelineConfigInfo(pipelineConfig, vkeSwapChain.width(), vkeSwapChain.height());
-		pipelineConfig.renderPass = vkeSwapChain.getRenderPass();
+		// No extent in the config: viewport & scissor are recorded per frame, so nothing here depends on the swap chain size
+		VkePipeline::defaultPipelineConfigInfo(pipelineConfig);
+		if (vkDerkDevice.extendedDynamicStateSupported()) {
+			VkePipeline::enableExtendedDynamicState(pipelineConfig);
+		}
+		// Only fetch the attributes the vertex shader actually reads (position only for simple_shader.vert), buffers are unchanged
+		vertShader->reflection().compactVertexInput(pipelineConfig.bindingDescriptions, pipelineConfig.attributeDescriptions);
+		pipelineConfig.renderPass = renderTarget->getRenderPass();
 		pipelineConfig.pipelineLayout = pipelineLayout;
-		vkePipeline = std::make_unique<VkePipeline>(
-			vkDerkDevice,
-			"simple_shader.vert.spv",
-			"simple_shader.frag.spv",
-			pipelineConfig);
+
+		pendingPipeline = pipelineRegistry.request(vertShader, fragShader, pipelineConfig);
 	}
 
-	// Command buffs recorded and submitted so they can be reused.
+	void VkeApplication::startShaderHotReload() {
+#ifdef VKE_SHADER_SOURCE_DIR
+		// Rebuilt .spv files land in the working directory, where the non-embedded build loads them from
+		shaderWatcher = std::make_unique<VkeShaderWatcher>(VKE_SHADER_SOURCE_DIR, ".", VKE_GLSL_COMPILER);
+		std::cout << "shader hot reload: watching " << VKE_SHADER_SOURCE_DIR << std::endl;
+#endif
+	}
+
+	// Never blocks: a reload that is still compiling is simply checked again next frame
+	void VkeApplication::pollShaderHotReload() {
+		if (!shaderWatcher) {
+			return;
+		}
+
+		if (pendingReload.valid()) {
+			if (pendingReload.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+				return;
+			}
+			try {
+				ReloadedPipeline reloaded = pendingReload.get();
+
+				// Frames in flight still use the old pipeline: it's destroyed once they have retired (deletion queue).
+				// The very first pipeline belongs to the registry and just stays there
+				// (std::function needs a copyable lambda, so the deletion queue takes over the raw pointer)
+				if (reloadedPipeline) {
+					VkePipeline* retired = reloadedPipeline.release();
+					vkDerkDevice.deletionQueue().push([retired]() { delete retired; });
+				}
+				reloadedPipeline = std::move(reloaded.pipeline);
+				vkePipeline = reloadedPipeline.get();
+				vertShader = std::move(reloaded.vertShader);
+				fragShader = std::move(reloaded.fragShader);
+				pipelineLayout = reloaded.pipelineLayout;
+				pipelineConfig = std::move(reloaded.config);
+				std::cout << "shader hot reload: pipeline swapped" << std::endl;
+			}
+			catch (const std::exception& e) {
+				// e.g. the shader now reads a vertex attribute the models don't have: keep drawing with the old one
+				std::cerr << "shader hot reload: rebuild failed, keeping the current pipeline: " << e.what() << std::endl;
+			}
+			return;
+		}
+
+		std::vector<std::string> rebuilt = shaderWatcher->takeRebuilt();
+		if (rebuilt.empty()) {
+			return;
+		}
+		// Only the edited stages are read back: the embedded build never writes the other stage's .spv,
+		// so an unedited stage keeps the module it already has
+		std::string vertPath = shaderWatcher->outputPath("simple_shader.vert");
+		std::string fragPath = shaderWatcher->outputPath("simple_shader.frag");
+		bool vertEdited = std::find(rebuilt.begin(), rebuilt.end(), vertPath) != rebuilt.end();
+		bool fragEdited = std::find(rebuilt.begin(), rebuilt.end(), fragPath) != rebuilt.end();
+		if (!vertEdited && !fragEdited) {
+			return;	// not one of ours
+		}
+
+		// Everything from reading the SPIR-V to the finished pipeline happens off the render thread.
+		// The vertex input starts from the full model layout again, the new shader may read more of it
+		PipelineConfigInfo config = pipelineConfig;
+		config.bindingDescriptions = VkeModel::Vertex::getBindingDescriptions();
+		config.attributeDescriptions = VkeModel::Vertex::getAttributeDescriptions();
+		VkeShaderRegistry::Handle currentVert = vertShader;
+		VkeShaderRegistry::Handle currentFrag = fragShader;
+		pendingReload = std::async(std::launch::async,
+			[this, config, vertEdited, fragEdited, vertPath, fragPath, currentVert, currentFrag]() mutable {
+			ReloadedPipeline reloaded{};
+			reloaded.vertShader = vertEdited ? vkDerkDevice.shaderRegistry().reload(vertPath) : currentVert;
+			reloaded.fragShader = fragEdited ? vkDerkDevice.shaderRegistry().reload(fragPath) : currentFrag;
+			reloaded.pipelineLayout = vkDerkDevice.pipelineLayoutCache().get(
+				VkePipelineLayoutDescription::merge({ &reloaded.vertShader->reflection(), &reloaded.fragShader->reflection() }));
+
+			reloaded.vertShader->reflection().compactVertexInput(config.bindingDescriptions, config.attributeDescriptions);
+			config.pipelineLayout = reloaded.pipelineLayout;
+			// Only the edited stage's part gets compiled, the rest is linked from parts already built
+			reloaded.pipeline = pipelineLibrary.create(reloaded.vertShader, reloaded.fragShader, config);
+			reloaded.config = std::move(config);
+			return reloaded;
+		});
+	}
+
+	// One command buffer per frame in flight, re-recorded every frame. The render target has waited on that frame's
+	// timeline value in acquireNextImage, so the buffer is free to reset by the time we record into it.
 	void VkeApplication::createCommandBuffers() {
 
-		commandBuffers.resize(vkeSwapChain.imageCount());	// for now, 1:1 commmand to frame buffer ratio
+		commandBuffers.resize(VkeRenderTarget::MAX_FRAMES_IN_FLIGHT);
 
 		VkCommandBufferAllocateInfo allocInfo{};
 		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -85,65 +306,126 @@ namespace vke {
 		if (vkAllocateCommandBuffers(vkDerkDevice.device(), &allocInfo, commandBuffers.data()) != VK_SUCCESS) {
 			throw std::runtime_error("failed to allocate command buffers");
 		}
+	}
 
-		// Record draw commands to buffers
-		for (int i = 0; i < commandBuffers.size(); i++) {
-			VkCommandBufferBeginInfo beginInfo{};
-			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	void VkeApplication::recordCommandBuffer(size_t frameIndex, uint32_t imageIndex) {
+		VkCommandBuffer commandBuffer = commandBuffers[frameIndex];
 
-			//std::cout << "beginning command buffer: " << i << '\n';
-			if (vkBeginCommandBuffer(commandBuffers[i], &beginInfo) != VK_SUCCESS) {
-				throw std::runtime_error("failed to begin recording command buffer!");
-			}
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
-			// First command: begin render pass
-			VkRenderPassBeginInfo renderPassInfo{};
-			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-			renderPassInfo.renderPass = vkeSwapChain.getRenderPass();
-			renderPassInfo.framebuffer = vkeSwapChain.getFrameBuffer(i);
-
-			// Setup render area
-			renderPassInfo.renderArea.offset = { 0,0 };
-			renderPassInfo.renderArea.extent = vkeSwapChain.getSwapChainExtent();	//make sure to use swap and not window exten
-
-			// Clear values (what vals we want frame buff to be initially cleared to)
-			// structured in a way that: 0 = color attatchment & 1 = depth attatchment
-			std::array<VkClearValue, 2> clearValues{};
-			clearValues[0].color = { 0.1f, 0.1f, 0.1f, 1.0f };
-			clearValues[1].depthStencil = { 1.0f, 0 };
-			renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-			renderPassInfo.pClearValues = clearValues.data();
-
-			// Begin render pass
-			vkCmdBeginRenderPass(commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);	//inline says that subsequent render commands are part of primary buffer (no secondary used)
-
-			// Bind pipeline & issue command
-			vkePipeline->bind(commandBuffers[i]);
-			//vkCmdDraw(commandBuffers[i], 3, 1, 0, 0);	// draw command: draw 3 vertices in only 1 instance
-			vkeModel->bind(commandBuffers[i]);
-			vkeModel->draw(commandBuffers[i]);
-
-			// End render pass
-			vkCmdEndRenderPass(commandBuffers[i]);
-			if (vkEndCommandBuffer(commandBuffers[i]) != VK_SUCCESS) {
-				throw std::runtime_error("failed to record command buffer!");
+		if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+			throw std::runtime_error("failed to begin recording command buffer!");
+		}
+
+		// First command: begin render pass
+		VkRenderPassBeginInfo renderPassInfo{};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassInfo.renderPass = renderTarget->getRenderPass();
+		renderPassInfo.framebuffer = renderTarget->getFrameBuffer(imageIndex);
+
+		// Setup render area
+		renderPassInfo.renderArea.offset = { 0,0 };
+		renderPassInfo.renderArea.extent = renderTarget->getExtent();	//make sure to use swap and not window exten
+
+		// Clear values (what vals we want frame buff to be initially cleared to)
+		// structured in a way that: 0 = color attatchment & 1 = depth attatchment
+		std::array<VkClearValue, 2> clearValues{};
+		clearValues[0].color = { 0.1f, 0.1f, 0.1f, 1.0f };
+		clearValues[1].depthStencil = { 1.0f, 0 };
+		renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+		renderPassInfo.pClearValues = clearValues.data();
+
+		// Begin render pass
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);	//inline says that subsequent render commands are part of primary buffer (no secondary used)
+
+		// Bind the mesh pool once, then one draw per model. Models still uploading are skipped this frame.
+		// Models sharing a pipeline state share the VkPipeline (registry), so binds only happen when it actually changes
+		VkPipeline boundPipeline = VK_NULL_HANDLE;
+		meshPool.bind(commandBuffer);
+		if (vkeModel->isReady()) {
+			if (vkePipeline->handle() != boundPipeline) {
+				vkePipeline->bind(commandBuffer);
+				boundPipeline = vkePipeline->handle();
+				VkePipeline::setViewportAndScissor(commandBuffer, renderTarget->getExtent());
+				if (VkePipeline::hasDynamicState(pipelineConfig, VK_DYNAMIC_STATE_CULL_MODE_EXT)) {
+					VkePipeline::setExtendedDynamicState(commandBuffer, vkDerkDevice.extendedDynamicState(), pipelineConfig);
+				}
+			}
+			if (!vkeModel->isPooled()) {
+				vkeModel->bind(commandBuffer);	// standalone model (vertex fetch benchmark): buffers of its own
 			}
+			vkeModel->draw(commandBuffer);
+		}
+
+		// End render pass
+		vkCmdEndRenderPass(commandBuffer);
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to record command buffer!");
+		}
+	}
 
+	// No vkDeviceWaitIdle: frames in flight finish on the old swap chain, which is retired through the deletion queue.
+	// Viewport & scissor are dynamic and recorded from the swap chain extent each frame, so pipelines and
+	// command buffers need nothing beyond the next recording
+	void VkeApplication::recreateSwapChain() {
+		vkeWindow->resetWindowResizedFlag();
+		vkeWindow->waitWhileMinimized();
+		VkExtent2D extent = vkeWindow->getExtent();
+		if (extent.width == 0 || extent.height == 0) {
+			return;	// closed while minimized
+		}
+		vkeSwapChain->recreate(extent);
+	}
+
+	// F1 low latency, F2 balanced, F3 max throughput. Holding a key re-selects the same policy, which is a no-op
+	void VkeApplication::pollPresentPolicyKeys() {
+		static const std::pair<int, VkePresentPolicy> bindings[] = {
+			{ GLFW_KEY_F1, VkePresentPolicy::LowLatency },
+			{ GLFW_KEY_F2, VkePresentPolicy::Balanced },
+			{ GLFW_KEY_F3, VkePresentPolicy::MaxThroughput },
+		};
+		for (const auto& binding : bindings) {
+			if (vkeWindow->isKeyPressed(binding.first) && vkeSwapChain->presentPolicy() != binding.second) {
+				vkeSwapChain->setPresentPolicy(binding.second);
+				return;
+			}
 		}
 	}
 
 	void VkeApplication::drawFrame() {
 		uint32_t imageIndex;
-		auto result = vkeSwapChain.acquireNextImage(&imageIndex);	// fetches index of the frame we should render to next (handles cpu+gpu sync)
+		auto result = renderTarget->acquireNextImage(&imageIndex);	// fetches index of the frame we should render to next (handles cpu+gpu sync)
 
+		// Window resized under us: nothing was acquired (semaphore untouched), rebuild and try again next frame.
+		// SUBOPTIMAL still acquired an image, draw it and recreate after presenting. The offscreen ring never returns either
+		if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+			recreateSwapChain();
+			return;
+		}
 		if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
 			throw std::runtime_error("failed to acquire swap chain image!");
 		}
 
-		result = vkeSwapChain.submitCommandBuffers(&commandBuffers[imageIndex], &imageIndex);	// submits provided command buffer TO graphics queue --> command buff then executed
-		if (result != VK_SUCCESS) {
+		// Submit whatever got staged since last frame and recycle finished uploads (never blocks)
+		vkDerkDevice.uploader().flush();
+		vkDerkDevice.uploader().collect();
+
+		// acquireNextImage waited on this frame's timeline value, so its ring region is free to overwrite
+		size_t frameIndex = renderTarget->getCurrentFrame();
+		frameRing.beginFrame(frameIndex);
+		recordCommandBuffer(frameIndex, imageIndex);
+
+		result = renderTarget->submitCommandBuffers(&commandBuffers[frameIndex], &imageIndex);	// submits provided command buffer TO graphics queue --> command buff then executed
+		if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || (vkeWindow && vkeWindow->wasWindowResized())) {
+			recreateSwapChain();
+		}
+		else if (result != VK_SUCCESS) {
 			throw std::runtime_error("failed to present swap chain image!");
 		}
 
+		// Move a few buffers out of sparsely used memory blocks, old copies die once in-flight frames retire
+		vkDerkDevice.defragmenter().step();
 	}
 }
\ No newline at end of file
@@ -1,26 +1,53 @@
 /* Application Header 
-	- HAS a vke window!
+	- HAS a vke window! (unless headless)
 */
 #pragma once
 
 #include "vke_window.hpp"
 #include "vke_pipeline.hpp"
+#include "vke_pipeline_builder.hpp"
+#include "vke_pipeline_library.hpp"
+#include "vke_pipeline_registry.hpp"
 #include "vk_derk_device.hpp"
 #include "vke_swap_chain.hpp"
+#include "vke_offscreen_ring.hpp"
 #include "vke_model.hpp"
+#include "vke_frame_ring.hpp"
+#include "vke_shader_watcher.hpp"
 
+#include <future>
 #include <memory>
 #include <vector>
 
 namespace vke {
 
+	struct VkeApplicationOptions {
+		VkePresentPolicy presentPolicy = VkePresentPolicy::Balanced;
+		// No window or surface: frames render into an offscreen ring as fast as the GPU goes, for batch jobs & benchmarks
+		bool headless = false;
+		uint32_t headlessFrames = 1000;		// frames vke_app_run renders headless before returning
+		// Seconds between memory stat dumps while windowed (headless dumps once at the end), 0 = off. On by default in debug builds, --memory-stats turns it on in release
+#ifdef NDEBUG
+		double memoryStatsInterval = 0.0;
+#else
+		double memoryStatsInterval = 10.0;
+#endif
+		// Headless only: draw a dense grid from host visible, then from device local vertex memory, headlessFrames each
+		bool benchmarkVertexFetch = false;
+	};
+
 	class VkeApplication {
 
 		public:
 			static constexpr int WIDTH = 800;
 			static constexpr int HEIGHT = 600;
+			static constexpr VkDeviceSize FRAME_RING_BYTES = 1024 * 1024;	// per frame in flight
+			static constexpr uint32_t MESH_POOL_VERTICES = 64 * 1024;		// initial capacity, the pool grows on demand
+			static constexpr uint32_t MESH_POOL_INDICES = 192 * 1024;
+			static constexpr uint32_t BENCHMARK_GRID_CELLS = 512;			// per side, 263k vertices & 1.5M indices
+			static constexpr double PIPELINE_CACHE_SAVE_INTERVAL = 60.0;	// seconds, so a crash doesn't lose a session's compiles
 
-			VkeApplication();
+			explicit VkeApplication(const VkeApplicationOptions& options = {});
 			~VkeApplication();
 
 			// delete copy constructors
@@ -33,24 +60,69 @@ namespace vke {
 		private:
 
 			void loadModels();
+			void loadShaders();
 			void createPipelineLayout();
 			void createPipeline();
 			void createCommandBuffers();
+			void recordCommandBuffer(size_t frameIndex, uint32_t imageIndex);
 			void drawFrame();
+			void runHeadless();
+			double timeHeadlessFrames(uint32_t frames);
+			void runVertexFetchBenchmark();
+			void recreateSwapChain();
+			void pollPresentPolicyKeys();
+			void startShaderHotReload();
+			void pollShaderHotReload();
+
+			VkeApplicationOptions options;
+
+			// Init this app's window! (null when headless, the device then skips the surface)
+			std::unique_ptr<VkeWindow> vkeWindow;
+			VkDerkDevice vkDerkDevice{ vkeWindow.get() };
+			// Exactly one of these exists, renderTarget points at it: the draw path only talks to renderTarget
+			std::unique_ptr<VkeSwapChain> vkeSwapChain;
+			std::unique_ptr<VkeOffscreenRing> offscreenRing;
+			VkeRenderTarget* renderTarget = nullptr;
 
-			// Init this app's window!
-			VkeWindow vkeWindow{WIDTH, HEIGHT, "VK Window..."};
-			VkDerkDevice vkDerkDevice{ vkeWindow };
-			VkeSwapChain vkeSwapChain{ vkDerkDevice, vkeWindow.getExtent() };
+			// Per-frame uniform / transient vertex data, persistently mapped and recycled with the frame timeline values
+			VkeFrameRing frameRing{ vkDerkDevice, FRAME_RING_BYTES, VkeRenderTarget::MAX_FRAMES_IN_FLIGHT };
+
+			// Pipelines are compiled on worker threads, createPipeline only queues them
+			VkePipelineBuilder pipelineBuilder{ vkDerkDevice };
+			// Identical pipeline states come back as the same pipeline, owns every pipeline the app uses
+			VkePipelineRegistry pipelineRegistry{ vkDerkDevice, pipelineBuilder };
+			// Variants linked from cached per-stage parts (or derived from a base pipeline), for reloads that shouldn't wait on a full compile
+			VkePipelineLibrary pipelineLibrary{ vkDerkDevice };
+
+			// Shared vertex/index arena for all models: one bind per frame, then a draw per model. Models in it use the default vertex layout
+			VkeMeshPool meshPool{ vkDerkDevice, VkeVertexLayout{}.stride(), MESH_POOL_VERTICES, MESH_POOL_INDICES };
 
 			// Init graphics pipeline! Removed for new unique pipeline
 			// VkePipeline vkePipeline{vkDerkDevice, "simple_shader.vert.spv", "simple_shader.frag.spv", VkePipeline::defaultPipelineConfigInfo(WIDTH, HEIGHT)};
 			
-			// Smart pointer!!! Automatically handles mem mgmt.
-			std::unique_ptr<VkePipeline> vkePipeline;
-			VkPipelineLayout pipelineLayout;
+			// Owned by pipelineRegistry
+			VkePipeline* vkePipeline = nullptr;
+			VkePipelineRegistry::Pending pendingPipeline;	// becomes vkePipeline once built
+			PipelineConfigInfo pipelineConfig{};			// kept for the values recorded as extended dynamic state
+			VkPipelineLayout pipelineLayout;	// owned by the device's pipeline layout cache
+			// Shaders: their reflection drives the pipeline layout & vertex input
+			VkeShaderRegistry::Handle vertShader;
+			VkeShaderRegistry::Handle fragShader;
 			std::vector<VkCommandBuffer> commandBuffers;
 			std::unique_ptr<VkeModel> vkeModel;
+
+			// Shader hot reload (builds with VKE_SHADER_SOURCE_DIR): the watcher recompiles edited GLSL, a background task
+			// reflects it and builds the replacement pipeline, pollShaderHotReload swaps it in between frames
+			struct ReloadedPipeline {
+				std::unique_ptr<VkePipeline> pipeline;
+				VkeShaderRegistry::Handle vertShader;
+				VkeShaderRegistry::Handle fragShader;
+				VkPipelineLayout pipelineLayout;
+				PipelineConfigInfo config;
+			};
+			std::unique_ptr<VkeShaderWatcher> shaderWatcher;
+			std::unique_ptr<VkePipeline> reloadedPipeline;	// owns vkePipeline once a reload has been swapped in
+			std::future<ReloadedPipeline> pendingReload;	// declared last: waited on before anything it uses goes away
 	};
 
 }
\ No newline at end of file
@@ -0,0 +1,74 @@
+# Turns a SPIR-V binary into a header with the words as a constexpr array:
+#
+#   cmake -DINPUT=simple_shader.vert.spv -DOUTPUT=simple_shader_vert.hpp -DSYMBOL=simple_shader_vert
+#         -P embed_spirv.cmake
+#
+# With -DSTAMP=<file> that file is touched on every run, for the build to track in place of the
+# header, whose timestamp only moves when its contents change.
+#
+# The array lands in namespace vke::shaders and can be handed to VkePipeline as a VkeSpirvSpan.
+
+foreach(var INPUT OUTPUT SYMBOL)
+  if(NOT DEFINED ${var})
+    message(FATAL_ERROR "embed_spirv.cmake: ${var} is not set")
+  endif()
+endforeach()
+
+file(READ "${INPUT}" hex HEX)
+string(LENGTH "${hex}" hex_length)
+math(EXPR byte_count "${hex_length} / 2")
+math(EXPR trailing_bytes "${byte_count} % 4")
+if(byte_count EQUAL 0 OR NOT trailing_bytes EQUAL 0)
+  message(FATAL_ERROR "embed_spirv.cmake: ${INPUT} is not a SPIR-V binary (${byte_count} bytes)")
+endif()
+
+# SPIR-V words are little endian on disk: bytes aa bb cc dd make the word 0xddccbbaa
+string(REGEX MATCHALL "........" byte_groups "${hex}")
+set(words "")
+set(column 0)
+foreach(group IN LISTS byte_groups)
+  string(SUBSTRING "${group}" 0 2 b0)
+  string(SUBSTRING "${group}" 2 2 b1)
+  string(SUBSTRING "${group}" 4 2 b2)
+  string(SUBSTRING "${group}" 6 2 b3)
+  string(APPEND words "0x${b3}${b2}${b1}${b0}u,")
+  math(EXPR column "${column} + 1")
+  if(column EQUAL 8)
+    string(APPEND words "\n    ")
+    set(column 0)
+  else()
+    string(APPEND words " ")
+  endif()
+endforeach()
+string(STRIP "${words}" words)
+
+list(GET byte_groups 0 magic)
+if(NOT magic STREQUAL "03022307")
+  message(FATAL_ERROR "embed_spirv.cmake: ${INPUT} does not start with the SPIR-V magic number")
+endif()
+
+get_filename_component(input_name "${INPUT}" NAME)
+math(EXPR word_count "${byte_count} / 4")
+file(WRITE "${OUTPUT}.tmp"
+"// Generated from ${input_name} by embed_spirv.cmake, do not edit.
+#pragma once
+
+#include <cstdint>
+
+namespace vke {
+namespace shaders {
+
+inline constexpr uint32_t ${SYMBOL}[${word_count}] = {
+    ${words}
+};
+
+}  // namespace shaders
+}  // namespace vke
+")
+# only touch the header when the words changed, so dependents don't rebuild for nothing
+# (copy_if_different rather than file(COPY_FILE ... ONLY_IF_DIFFERENT), which needs CMake 3.21)
+execute_process(COMMAND "${CMAKE_COMMAND}" -E copy_if_different "${OUTPUT}.tmp" "${OUTPUT}")
+file(REMOVE "${OUTPUT}.tmp")
+if(DEFINED STAMP)
+  file(TOUCH "${STAMP}")
+endif()
@@ -1,13 +1,50 @@
 #include "app_ctrl.hpp"
 
+#include <cctype>
 #include <cstdlib>
 #include <iostream>
 #include <stdexcept>
+#include <string>
 
-int main() {
+int main(int argc, char** argv) {
 
-	// Init an app instance (which has a window)
-	vke::VkeApplication app{};
+	// --present-policy low-latency|balanced|max-throughput (switch live with F1/F2/F3)
+	// --headless [frames]: no window, render that many frames offscreen (default 1000) and print the frame rate
+	// --benchmark-vertex-fetch [frames]: headless, time a dense grid in host visible vs device local vertex memory
+	// --memory-stats [seconds]: dump allocator stats every that many seconds (default 10), 0 turns it off
+	vke::VkeApplicationOptions options;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--present-policy" && i + 1 < argc && vke::VkeSwapChain::parsePresentPolicy(argv[i + 1], options.presentPolicy)) {
+			i++;
+		}
+		else if (arg == "--headless") {
+			options.headless = true;
+			if (i + 1 < argc && std::isdigit(static_cast<unsigned char>(argv[i + 1][0]))) {
+				options.headlessFrames = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+			}
+		}
+		else if (arg == "--benchmark-vertex-fetch") {
+			options.headless = true;
+			options.benchmarkVertexFetch = true;
+			if (i + 1 < argc && std::isdigit(static_cast<unsigned char>(argv[i + 1][0]))) {
+				options.headlessFrames = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+			}
+		}
+		else if (arg == "--memory-stats") {
+			options.memoryStatsInterval = 10.0;
+			if (i + 1 < argc && std::isdigit(static_cast<unsigned char>(argv[i + 1][0]))) {
+				options.memoryStatsInterval = std::strtod(argv[++i], nullptr);
+			}
+		}
+		else {
+			std::cerr << "usage: " << argv[0] << " [--present-policy low-latency|balanced|max-throughput] [--headless [frames]] [--benchmark-vertex-fetch [frames]] [--memory-stats [seconds]]" << '\n';
+			return EXIT_FAILURE;
+		}
+	}
+
+	// Init an app instance (which has a window, unless headless)
+	vke::VkeApplication app{ options };
 
 	// Try launch. If error thrown, spit to console.
 	try {
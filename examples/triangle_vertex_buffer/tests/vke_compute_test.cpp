@@ -0,0 +1,139 @@
+// Runs tests/double_values.comp through VkeComputePipeline on a headless device (lavapipe works)
+// and checks the buffer it wrote. Exit code 0 on success, ctest reports anything else.
+
+#include "vk_derk_device.hpp"
+#include "vke_compute_pipeline.hpp"
+
+// generated by embed_spirv.cmake at build time
+#include "double_values_comp.hpp"
+
+// std lib headers
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+
+constexpr uint32_t COUNT = 1000;     // not a multiple of the 64 wide workgroup
+constexpr uint32_t CAPACITY = 1024;  // values past COUNT must come back untouched
+
+int run() {
+  vke::VkDerkDevice device{nullptr};
+  vke::VkeComputePipeline pipeline{device, vke::VkeSpirvSpan{vke::shaders::double_values_comp}};
+
+  VkBuffer buffer;
+  vke::VkeAllocation allocation;
+  device.createBuffer(
+      CAPACITY * sizeof(uint32_t),
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+      buffer,
+      allocation);
+  auto *values = static_cast<uint32_t *>(allocation.mapped);
+  for (uint32_t i = 0; i < CAPACITY; i++) {
+    values[i] = i;
+  }
+
+  VkDescriptorPoolSize poolSize{};
+  poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  poolSize.descriptorCount = 1;
+  VkDescriptorPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.maxSets = 1;
+  poolInfo.poolSizeCount = 1;
+  poolInfo.pPoolSizes = &poolSize;
+  VkDescriptorPool descriptorPool;
+  if (vkCreateDescriptorPool(device.device(), &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create descriptor pool!");
+  }
+
+  VkDescriptorSetAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorPool = descriptorPool;
+  allocInfo.descriptorSetCount = 1;
+  allocInfo.pSetLayouts = &pipeline.descriptorSetLayouts()[0];
+  VkDescriptorSet descriptorSet;
+  if (vkAllocateDescriptorSets(device.device(), &allocInfo, &descriptorSet) != VK_SUCCESS) {
+    throw std::runtime_error("failed to allocate descriptor set!");
+  }
+
+  VkDescriptorBufferInfo bufferInfo{};
+  bufferInfo.buffer = buffer;
+  bufferInfo.offset = 0;
+  bufferInfo.range = VK_WHOLE_SIZE;
+  VkWriteDescriptorSet write{};
+  write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  write.dstSet = descriptorSet;
+  write.dstBinding = 0;
+  write.descriptorCount = 1;
+  write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  write.pBufferInfo = &bufferInfo;
+  vkUpdateDescriptorSets(device.device(), 1, &write, 0, nullptr);
+
+  VkCommandBuffer commandBuffer = device.beginSingleTimeCommands();
+  pipeline.bind(commandBuffer);
+  vkCmdBindDescriptorSets(
+      commandBuffer,
+      VK_PIPELINE_BIND_POINT_COMPUTE,
+      pipeline.layout(),
+      0,
+      1,
+      &descriptorSet,
+      0,
+      nullptr);
+  pipeline.pushConstants(commandBuffer, &COUNT, sizeof(COUNT));
+  pipeline.dispatchInvocations(commandBuffer, COUNT);
+
+  // shader writes visible to the host once endSingleTimeCommands has waited for the queue
+  VkMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+  vkCmdPipelineBarrier(
+      commandBuffer,
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      VK_PIPELINE_STAGE_HOST_BIT,
+      0,
+      1,
+      &barrier,
+      0,
+      nullptr,
+      0,
+      nullptr);
+  device.endSingleTimeCommands(commandBuffer);
+
+  int failures = 0;
+  for (uint32_t i = 0; i < CAPACITY; i++) {
+    uint32_t expected = i < COUNT ? i * 2 : i;
+    if (values[i] != expected) {
+      if (failures < 10) {
+        std::cerr << "values[" << i << "] = " << values[i] << ", expected " << expected << '\n';
+      }
+      failures++;
+    }
+  }
+
+  vkDestroyDescriptorPool(device.device(), descriptorPool, nullptr);
+  device.destroyBuffer(buffer, allocation);
+
+  if (failures != 0) {
+    std::cerr << failures << " of " << CAPACITY << " values wrong\n";
+    return EXIT_FAILURE;
+  }
+  std::cout << "dispatchInvocations(" << COUNT << ") with local_size_x "
+            << pipeline.localSize()[0] << ": ok\n";
+  return EXIT_SUCCESS;
+}
+
+}  // namespace
+
+int main() {
+  try {
+    return run();
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << '\n';
+    return EXIT_FAILURE;
+  }
+}
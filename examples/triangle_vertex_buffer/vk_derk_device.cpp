@@ -2,6 +2,7 @@
 
 // std headers
 #include <cstring>
+#include <iomanip>
 #include <iostream>
 #include <set>
 #include <unordered_set>
@@ -49,16 +50,33 @@ void DestroyDebugUtilsMessengerEXT(
 }
 
 // Vulkan Derk Device Constructor!!!
-VkDerkDevice::VkDerkDevice(VkeWindow &window) : window{window} {
+VkDerkDevice::VkDerkDevice(VkeWindow *window) : window{window} {
   createInstance();         // setup vulkan instance
   setupDebugMessenger();    // setup validation layers (vulkan by default does not do alot of error checking = crashes), so for debugging enable and release disable
-  createSurface();          // connection btwn window and vulkan
+  createSurface();          // connection btwn window and vulkan (none when headless)
   pickPhysicalDevice();     // physical device (GPU) that will work w vulkan & run program
   createLogicalDevice();    // logical device: describes features of physical device that we want to use
+  createTimelines();        // per queue timeline semaphores, frame & upload completion
   createCommandPool();      // used for buffer allocation
+  createAllocator();        // sub-allocates buffer/image memory out of large blocks
+  createUploader();         // async staging uploads on the transfer queue
+  createDefragmenter();     // incremental buffer compaction, stepped once per frame
+  createPipelineCache();    // compiled pipelines from earlier runs, saved again on shutdown
+  createShaderRegistry();   // shader modules shared by content hash
+  createPipelineLayoutCache();  // descriptor set / pipeline layouts from shader reflection
 }
 
 VkDerkDevice::~VkDerkDevice() {
+  pipelineLayoutCache_.reset();
+  shaderRegistry_.reset();
+  pipelineCache_.reset();
+  defragmenter_.reset();
+  uploader_.reset();
+  deletionQueue_->flush();
+  deletionQueue_.reset();
+  allocator_.reset();
+  transferTimeline_.reset();
+  graphicsTimeline_.reset();
   vkDestroyCommandPool(device_, commandPool, nullptr);
   vkDestroyDevice(device_, nullptr);
 
@@ -66,7 +84,9 @@ VkDerkDevice::~VkDerkDevice() {
     DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
   }
 
-  vkDestroySurfaceKHR(instance, surface_, nullptr);
+  if (surface_ != VK_NULL_HANDLE) {
+    vkDestroySurfaceKHR(instance, surface_, nullptr);
+  }
   vkDestroyInstance(instance, nullptr);
 }
 
@@ -81,13 +101,19 @@ void VkDerkDevice::createInstance() {
   appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
   appInfo.pEngineName = "No Engine";
   appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-  appInfo.apiVersion = VK_API_VERSION_1_0;
+  appInfo.apiVersion = VK_API_VERSION_1_2;  // timeline semaphores
 
   VkInstanceCreateInfo createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
   createInfo.pApplicationInfo = &appInfo;
 
   auto extensions = getRequiredExtensions();
+
+  // optional: needed for VK_EXT_memory_budget queries
+  if (isInstanceExtensionAvailable(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME)) {
+    extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+    physicalDeviceProperties2Enabled = true;
+  }
   createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
   createInfo.ppEnabledExtensionNames = extensions.data();
 
@@ -137,9 +163,13 @@ void VkDerkDevice::pickPhysicalDevice() {
 
 void VkDerkDevice::createLogicalDevice() {
   QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
+  queueFamilyIndices_ = indices;
 
   std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-  std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily, indices.presentFamily};
+  std::set<uint32_t> uniqueQueueFamilies = {
+      indices.graphicsFamily,
+      indices.presentFamily,
+      indices.transferFamily};
 
   float queuePriority = 1.0f;
   for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -160,9 +190,70 @@ void VkDerkDevice::createLogicalDevice() {
   createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
   createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
+  // required extensions plus whichever optional ones this device has
+  std::vector<const char *> enabledExtensions = getRequiredDeviceExtensions();
+  if (physicalDeviceProperties2Enabled &&
+      isDeviceExtensionAvailable(physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)) {
+    enabledExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    getMemoryProperties2 = (PFN_vkGetPhysicalDeviceMemoryProperties2KHR)vkGetInstanceProcAddr(
+        instance,
+        "vkGetPhysicalDeviceMemoryProperties2KHR");
+    memoryBudgetSupported_ = getMemoryProperties2 != nullptr;
+  }
+
+  // required (isDeviceSuitable): frame and upload completion are timeline semaphore values
+  VkPhysicalDeviceVulkan12Features vulkan12Features{};
+  vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+  vulkan12Features.timelineSemaphore = VK_TRUE;
+  createInfo.pNext = &vulkan12Features;
+
+  // optional features, queried once for the blocks below
+  SupportedFeatures supported = querySupportedFeatures(physicalDevice);
+
+  // optional: lets pipelines leave cull mode and depth state to the command buffer
+  VkPhysicalDeviceExtendedDynamicStateFeaturesEXT extendedDynamicStateFeatures{};
+  extendedDynamicStateFeatures.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+  bool enableExtendedDynamicState = supported.extendedDynamicState;
+  if (enableExtendedDynamicState) {
+    enabledExtensions.push_back(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME);
+    extendedDynamicStateFeatures.extendedDynamicState = VK_TRUE;
+    extendedDynamicStateFeatures.pNext = const_cast<void *>(createInfo.pNext);
+    createInfo.pNext = &extendedDynamicStateFeatures;
+  }
+
+#ifdef VK_EXT_graphics_pipeline_library
+  // optional: pipelines linked from separately compiled stage libraries (VkePipelineLibrary)
+  VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT graphicsPipelineLibraryFeatures{};
+  graphicsPipelineLibraryFeatures.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+  if (supported.graphicsPipelineLibrary) {
+    enabledExtensions.push_back(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME);
+    enabledExtensions.push_back(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME);
+    graphicsPipelineLibraryFeatures.graphicsPipelineLibrary = VK_TRUE;
+    graphicsPipelineLibraryFeatures.pNext = const_cast<void *>(createInfo.pNext);
+    createInfo.pNext = &graphicsPipelineLibraryFeatures;
+    graphicsPipelineLibrarySupported_ = true;
+  }
+#endif
+
+#ifdef VK_EXT_present_mode_fifo_latest_ready
+  // optional: FIFO that presents the newest ready image, for the low latency present policy
+  VkPhysicalDevicePresentModeFifoLatestReadyFeaturesEXT fifoLatestReadyFeatures{};
+  fifoLatestReadyFeatures.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_MODE_FIFO_LATEST_READY_FEATURES_EXT;
+  if (!headless() && supported.presentModeFifoLatestReady) {
+    enabledExtensions.push_back(VK_EXT_PRESENT_MODE_FIFO_LATEST_READY_EXTENSION_NAME);
+    fifoLatestReadyFeatures.presentModeFifoLatestReady = VK_TRUE;
+    fifoLatestReadyFeatures.pNext = const_cast<void *>(createInfo.pNext);
+    createInfo.pNext = &fifoLatestReadyFeatures;
+    presentModeFifoLatestReadySupported_ = true;
+  }
+#endif
+
   createInfo.pEnabledFeatures = &deviceFeatures;
-  createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-  createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+  createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+  createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
   // might not really be necessary anymore because device specific validation layers
   // have been deprecated
@@ -179,6 +270,81 @@ void VkDerkDevice::createLogicalDevice() {
 
   vkGetDeviceQueue(device_, indices.graphicsFamily, 0, &graphicsQueue_);
   vkGetDeviceQueue(device_, indices.presentFamily, 0, &presentQueue_);
+  vkGetDeviceQueue(device_, indices.transferFamily, 0, &transferQueue_);
+
+  if (enableExtendedDynamicState) {
+    loadExtendedDynamicStateFns();
+  }
+}
+
+// One vkGetPhysicalDeviceFeatures2 for every feature the device code branches on. Extension
+// structs are only chained when the device lists the extension, so their flags stay false otherwise.
+// Core since Vulkan 1.2, which isDeviceSuitable already requires.
+VkDerkDevice::SupportedFeatures VkDerkDevice::querySupportedFeatures(VkPhysicalDevice device) {
+  VkPhysicalDeviceFeatures2 features2{};
+  features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+
+  VkPhysicalDeviceVulkan12Features vulkan12Features{};
+  vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+  vulkan12Features.pNext = features2.pNext;
+  features2.pNext = &vulkan12Features;
+
+  VkPhysicalDeviceExtendedDynamicStateFeaturesEXT extendedDynamicStateFeatures{};
+  extendedDynamicStateFeatures.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+  if (isDeviceExtensionAvailable(device, VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME)) {
+    extendedDynamicStateFeatures.pNext = features2.pNext;
+    features2.pNext = &extendedDynamicStateFeatures;
+  }
+
+#ifdef VK_EXT_graphics_pipeline_library
+  VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT graphicsPipelineLibraryFeatures{};
+  graphicsPipelineLibraryFeatures.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+  if (isDeviceExtensionAvailable(device, VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME) &&
+      isDeviceExtensionAvailable(device, VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME)) {
+    graphicsPipelineLibraryFeatures.pNext = features2.pNext;
+    features2.pNext = &graphicsPipelineLibraryFeatures;
+  }
+#endif
+
+#ifdef VK_EXT_present_mode_fifo_latest_ready
+  VkPhysicalDevicePresentModeFifoLatestReadyFeaturesEXT fifoLatestReadyFeatures{};
+  fifoLatestReadyFeatures.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_MODE_FIFO_LATEST_READY_FEATURES_EXT;
+  if (isDeviceExtensionAvailable(device, VK_EXT_PRESENT_MODE_FIFO_LATEST_READY_EXTENSION_NAME)) {
+    fifoLatestReadyFeatures.pNext = features2.pNext;
+    features2.pNext = &fifoLatestReadyFeatures;
+  }
+#endif
+
+  vkGetPhysicalDeviceFeatures2(device, &features2);
+
+  SupportedFeatures supported;
+  supported.timelineSemaphore = vulkan12Features.timelineSemaphore == VK_TRUE;
+  supported.extendedDynamicState = extendedDynamicStateFeatures.extendedDynamicState == VK_TRUE;
+#ifdef VK_EXT_graphics_pipeline_library
+  supported.graphicsPipelineLibrary =
+      graphicsPipelineLibraryFeatures.graphicsPipelineLibrary == VK_TRUE;
+#endif
+#ifdef VK_EXT_present_mode_fifo_latest_ready
+  supported.presentModeFifoLatestReady =
+      fifoLatestReadyFeatures.presentModeFifoLatestReady == VK_TRUE;
+#endif
+  return supported;
+}
+
+void VkDerkDevice::loadExtendedDynamicStateFns() {
+  extendedDynamicState_.setCullMode =
+      (PFN_vkCmdSetCullModeEXT)vkGetDeviceProcAddr(device_, "vkCmdSetCullModeEXT");
+  extendedDynamicState_.setFrontFace =
+      (PFN_vkCmdSetFrontFaceEXT)vkGetDeviceProcAddr(device_, "vkCmdSetFrontFaceEXT");
+  extendedDynamicState_.setDepthTestEnable =
+      (PFN_vkCmdSetDepthTestEnableEXT)vkGetDeviceProcAddr(device_, "vkCmdSetDepthTestEnableEXT");
+  extendedDynamicState_.setDepthWriteEnable =
+      (PFN_vkCmdSetDepthWriteEnableEXT)vkGetDeviceProcAddr(device_, "vkCmdSetDepthWriteEnableEXT");
+  extendedDynamicState_.setDepthCompareOp =
+      (PFN_vkCmdSetDepthCompareOpEXT)vkGetDeviceProcAddr(device_, "vkCmdSetDepthCompareOpEXT");
 }
 
 void VkDerkDevice::createCommandPool() {
@@ -195,15 +361,49 @@ void VkDerkDevice::createCommandPool() {
   }
 }
 
-void VkDerkDevice::createSurface() { window.createWindowSurface(instance, &surface_); }
+void VkDerkDevice::createTimelines() {
+  graphicsTimeline_ = std::make_unique<VkeTimeline>(device_);
+  transferTimeline_ = std::make_unique<VkeTimeline>(device_);
+  // destroyed objects wait for the graphics queue, where everything that uses them is submitted
+  deletionQueue_ = std::make_unique<VkeDeletionQueue>(*graphicsTimeline_);
+}
+
+void VkDerkDevice::createAllocator() {
+  allocator_ = std::make_unique<VkeAllocator>(physicalDevice, device_);
+}
+
+void VkDerkDevice::createUploader() { uploader_ = std::make_unique<VkeUploader>(*this); }
+
+void VkDerkDevice::createPipelineCache() {
+  pipelineCache_ = std::make_unique<VkePipelineCache>(device_, properties, PIPELINE_CACHE_FILE);
+}
+
+void VkDerkDevice::createShaderRegistry() {
+  shaderRegistry_ = std::make_unique<VkeShaderRegistry>(device_);
+}
+
+void VkDerkDevice::createPipelineLayoutCache() {
+  pipelineLayoutCache_ = std::make_unique<VkePipelineLayoutCache>(device_);
+}
+
+void VkDerkDevice::createDefragmenter() {
+  defragmenter_ = std::make_unique<VkeDefragmenter>(*this);
+}
+
+void VkDerkDevice::createSurface() {
+  if (!headless()) {
+    window->createWindowSurface(instance, &surface_);
+  }
+}
 
 bool VkDerkDevice::isDeviceSuitable(VkPhysicalDevice device) {
   QueueFamilyIndices indices = findQueueFamilies(device);
 
   bool extensionsSupported = checkDeviceExtensionSupport(device);
 
-  bool swapChainAdequate = false;
-  if (extensionsSupported) {
+  // headless: nothing is presented, any device that renders will do
+  bool swapChainAdequate = headless();
+  if (extensionsSupported && !headless()) {
     SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
     swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
   }
@@ -212,7 +412,18 @@ bool VkDerkDevice::isDeviceSuitable(VkPhysicalDevice device) {
   vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
 
   return indices.isComplete() && extensionsSupported && swapChainAdequate &&
-         supportedFeatures.samplerAnisotropy;
+         supportedFeatures.samplerAnisotropy && supportsTimelineSemaphores(device);
+}
+
+// Vulkan 1.2 device with the timelineSemaphore feature, what frame & upload sync is built on
+bool VkDerkDevice::supportsTimelineSemaphores(VkPhysicalDevice device) {
+  VkPhysicalDeviceProperties deviceProperties;
+  vkGetPhysicalDeviceProperties(device, &deviceProperties);
+  if (deviceProperties.apiVersion < VK_API_VERSION_1_2) {
+    return false;
+  }
+
+  return querySupportedFeatures(device).timelineSemaphore;
 }
 
 void VkDerkDevice::populateDebugMessengerCreateInfo(
@@ -264,11 +475,14 @@ bool VkDerkDevice::checkValidationLayerSupport() {
 }
 
 std::vector<const char *> VkDerkDevice::getRequiredExtensions() {
-  uint32_t glfwExtensionCount = 0;
-  const char **glfwExtensions;
-  glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-
-  std::vector<const char *> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+  // surface extensions come from glfw, headless needs none (and never initializes glfw)
+  std::vector<const char *> extensions;
+  if (!headless()) {
+    uint32_t glfwExtensionCount = 0;
+    const char **glfwExtensions;
+    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+  }
 
   if (enableValidationLayers) {
     extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -277,6 +491,13 @@ std::vector<const char *> VkDerkDevice::getRequiredExtensions() {
   return extensions;
 }
 
+std::vector<const char *> VkDerkDevice::getRequiredDeviceExtensions() {
+  if (headless()) {
+    return {};
+  }
+  return deviceExtensions;
+}
+
 void VkDerkDevice::hasGflwRequiredInstanceExtensions() {
   uint32_t extensionCount = 0;
   vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
@@ -311,6 +532,7 @@ bool VkDerkDevice::checkDeviceExtensionSupport(VkPhysicalDevice device) {
       &extensionCount,
       availableExtensions.data());
 
+  std::vector<const char *> deviceExtensions = getRequiredDeviceExtensions();
   std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
 
   for (const auto &extension : availableExtensions) {
@@ -320,6 +542,34 @@ bool VkDerkDevice::checkDeviceExtensionSupport(VkPhysicalDevice device) {
   return requiredExtensions.empty();
 }
 
+bool VkDerkDevice::isInstanceExtensionAvailable(const char *extensionName) {
+  uint32_t extensionCount = 0;
+  vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
+  std::vector<VkExtensionProperties> extensions(extensionCount);
+  vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, extensions.data());
+
+  for (const auto &extension : extensions) {
+    if (strcmp(extension.extensionName, extensionName) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool VkDerkDevice::isDeviceExtensionAvailable(VkPhysicalDevice device, const char *extensionName) {
+  uint32_t extensionCount = 0;
+  vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+  std::vector<VkExtensionProperties> extensions(extensionCount);
+  vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, extensions.data());
+
+  for (const auto &extension : extensions) {
+    if (strcmp(extension.extensionName, extensionName) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
 QueueFamilyIndices VkDerkDevice::findQueueFamilies(VkPhysicalDevice device) {
   QueueFamilyIndices indices;
 
@@ -336,7 +586,12 @@ QueueFamilyIndices VkDerkDevice::findQueueFamilies(VkPhysicalDevice device) {
       indices.graphicsFamilyHasValue = true;
     }
     VkBool32 presentSupport = false;
-    vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
+    if (headless()) {
+      presentSupport =
+          indices.graphicsFamilyHasValue && indices.graphicsFamily == static_cast<uint32_t>(i);
+    } else {
+      vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
+    }
     if (queueFamily.queueCount > 0 && presentSupport) {
       indices.presentFamily = i;
       indices.presentFamilyHasValue = true;
@@ -348,6 +603,24 @@ QueueFamilyIndices VkDerkDevice::findQueueFamilies(VkPhysicalDevice device) {
     i++;
   }
 
+  // Prefer a transfer-only family (the DMA engine on discrete GPUs), then any non-graphics family
+  // with transfer support. Without one, uploads share the graphics queue.
+  indices.transferFamily = indices.graphicsFamily;
+  int bestScore = 0;
+  for (uint32_t family = 0; family < queueFamilyCount; family++) {
+    const auto &queueFamily = queueFamilies[family];
+    if (queueFamily.queueCount == 0 || !(queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) ||
+        (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
+      continue;
+    }
+    int score = (queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT) ? 1 : 2;
+    if (score > bestScore) {
+      bestScore = score;
+      indices.transferFamily = family;
+      indices.dedicatedTransferFamily = true;
+    }
+  }
+
   return indices;
 }
 
@@ -406,35 +679,53 @@ uint32_t VkDerkDevice::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags
   throw std::runtime_error("failed to find suitable memory type!");
 }
 
-void VkDerkDevice::createBuffer(
-    VkDeviceSize size,
-    VkBufferUsageFlags usage,
-    VkMemoryPropertyFlags properties,
-    VkBuffer &buffer,
-    VkDeviceMemory &bufferMemory) {
+VkBuffer VkDerkDevice::createBufferObject(VkDeviceSize size, VkBufferUsageFlags usage) {
   VkBufferCreateInfo bufferInfo{};
   bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
   bufferInfo.size = size;
   bufferInfo.usage = usage;
   bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
+  // Copies to and from these buffers may run on the transfer queue (uploads, defragmentation) while
+  // graphics reads them. Concurrent sharing avoids queue family ownership transfers.
+  QueueFamilyIndices indices = findPhysicalQueueFamilies();
+  uint32_t queueFamilyIndices[] = {indices.graphicsFamily, indices.transferFamily};
+  if ((usage & (VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT)) &&
+      indices.dedicatedTransferFamily) {
+    bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+    bufferInfo.queueFamilyIndexCount = 2;
+    bufferInfo.pQueueFamilyIndices = queueFamilyIndices;
+  }
+
+  VkBuffer buffer;
   if (vkCreateBuffer(device_, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
     throw std::runtime_error("failed to create vertex buffer!");
   }
+  return buffer;
+}
+
+void VkDerkDevice::createBuffer(
+    VkDeviceSize size,
+    VkBufferUsageFlags usage,
+    VkMemoryPropertyFlags properties,
+    VkBuffer &buffer,
+    VkeAllocation &bufferAllocation) {
+  buffer = createBufferObject(size, usage);
 
   VkMemoryRequirements memRequirements;
   vkGetBufferMemoryRequirements(device_, buffer, &memRequirements);
 
-  VkMemoryAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocInfo.allocationSize = memRequirements.size;
-  allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+  bufferAllocation = allocator_->allocate(memRequirements, properties, VkeResourceKind::Linear);
 
-  if (vkAllocateMemory(device_, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-    throw std::runtime_error("failed to allocate vertex buffer memory!");
+  if (vkBindBufferMemory(device_, buffer, bufferAllocation.memory, bufferAllocation.offset) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to bind vertex buffer memory!");
   }
+}
 
-  vkBindBufferMemory(device_, buffer, bufferMemory, 0);
+void VkDerkDevice::destroyBuffer(VkBuffer buffer, VkeAllocation &bufferAllocation) {
+  vkDestroyBuffer(device_, buffer, nullptr);
+  allocator_->free(bufferAllocation);
 }
 
 VkCommandBuffer VkDerkDevice::beginSingleTimeCommands() {
@@ -458,13 +749,8 @@ VkCommandBuffer VkDerkDevice::beginSingleTimeCommands() {
 void VkDerkDevice::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
   vkEndCommandBuffer(commandBuffer);
 
-  VkSubmitInfo submitInfo{};
-  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-  submitInfo.commandBufferCount = 1;
-  submitInfo.pCommandBuffers = &commandBuffer;
-
-  vkQueueSubmit(graphicsQueue_, 1, &submitInfo, VK_NULL_HANDLE);
-  vkQueueWaitIdle(graphicsQueue_);
+  // wait on this submission only instead of draining the whole graphics queue
+  graphicsTimeline_->wait(graphicsTimeline_->submit(graphicsQueue_, 1, &commandBuffer));
 
   vkFreeCommandBuffers(device_, commandPool, 1, &commandBuffer);
 }
@@ -512,7 +798,7 @@ void VkDerkDevice::createImageWithInfo(
     const VkImageCreateInfo &imageInfo,
     VkMemoryPropertyFlags properties,
     VkImage &image,
-    VkDeviceMemory &imageMemory) {
+    VkeAllocation &imageAllocation) {
   if (vkCreateImage(device_, &imageInfo, nullptr, &image) != VK_SUCCESS) {
     throw std::runtime_error("failed to create image!");
   }
@@ -520,18 +806,126 @@ void VkDerkDevice::createImageWithInfo(
   VkMemoryRequirements memRequirements;
   vkGetImageMemoryRequirements(device_, image, &memRequirements);
 
-  VkMemoryAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocInfo.allocationSize = memRequirements.size;
-  allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+  VkeResourceKind kind =
+      imageInfo.tiling == VK_IMAGE_TILING_LINEAR ? VkeResourceKind::Linear : VkeResourceKind::Optimal;
+  imageAllocation = allocator_->allocate(memRequirements, properties, kind);
 
-  if (vkAllocateMemory(device_, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-    throw std::runtime_error("failed to allocate image memory!");
+  if (vkBindImageMemory(device_, image, imageAllocation.memory, imageAllocation.offset) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to bind image memory!");
   }
+}
 
-  if (vkBindImageMemory(device_, image, imageMemory, 0) != VK_SUCCESS) {
-    throw std::runtime_error("failed to bind image memory!");
+void VkDerkDevice::destroyImage(VkImage image, VkeAllocation &imageAllocation) {
+  vkDestroyImage(device_, image, nullptr);
+  allocator_->free(imageAllocation);
+}
+
+void VkDerkDevice::createAliasedImages(
+    const VkImageCreateInfo &imageInfo,
+    uint32_t count,
+    VkMemoryPropertyFlags properties,
+    std::vector<VkImage> &images,
+    VkeAllocation &sharedAllocation) {
+  images.resize(count);
+  for (uint32_t i = 0; i < count; i++) {
+    if (vkCreateImage(device_, &imageInfo, nullptr, &images[i]) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create image!");
+    }
+  }
+
+  // identical create infos give identical requirements, the first image speaks for all of them
+  VkMemoryRequirements memRequirements;
+  vkGetImageMemoryRequirements(device_, images[0], &memRequirements);
+
+  VkeResourceKind kind =
+      imageInfo.tiling == VK_IMAGE_TILING_LINEAR ? VkeResourceKind::Linear : VkeResourceKind::Optimal;
+  sharedAllocation = allocator_->allocate(memRequirements, properties, kind);
+
+  for (VkImage image : images) {
+    if (vkBindImageMemory(device_, image, sharedAllocation.memory, sharedAllocation.offset) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("failed to bind image memory!");
+    }
+  }
+}
+
+void VkDerkDevice::destroyAliasedImages(
+    std::vector<VkImage> &images, VkeAllocation &sharedAllocation) {
+  for (VkImage image : images) {
+    vkDestroyImage(device_, image, nullptr);
+  }
+  images.clear();
+  allocator_->free(sharedAllocation);
+}
+
+bool VkDerkDevice::supportsLazilyAllocatedMemory(uint32_t typeBits) {
+  const VkPhysicalDeviceMemoryProperties &memProperties = allocator_->memoryProperties();
+  for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+    if ((typeBits & (1u << i)) &&
+        (memProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT)) {
+      return true;
+    }
   }
+  return false;
+}
+
+VkeMemoryStats VkDerkDevice::getMemoryStats() {
+  VkeMemoryStats stats = allocator_->getStats();
+
+  if (memoryBudgetSupported_) {
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+    budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+    VkPhysicalDeviceMemoryProperties2KHR memProperties2{};
+    memProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+    memProperties2.pNext = &budgetProperties;
+    getMemoryProperties2(physicalDevice, &memProperties2);
+
+    for (size_t i = 0; i < stats.heaps.size(); i++) {
+      stats.heaps[i].budget = budgetProperties.heapBudget[i];
+      stats.heaps[i].processUsage = budgetProperties.heapUsage[i];
+    }
+    stats.budgetAvailable = true;
+  }
+  return stats;
+}
+
+void VkDerkDevice::dumpMemoryStats(std::ostream &out) {
+  const double MiB = 1024.0 * 1024.0;
+  VkeMemoryStats stats = getMemoryStats();
+  auto flags = out.flags();
+  out << std::fixed << std::setprecision(2);
+
+  out << "memory stats: " << stats.total.usedBytes / MiB << " MiB used in "
+      << stats.total.blockBytes / MiB << " MiB (" << stats.total.blockCount << " blocks, "
+      << stats.total.allocationCount << " allocations)" << std::endl;
+
+  for (size_t i = 0; i < stats.heaps.size(); i++) {
+    const auto &heap = stats.heaps[i];
+    out << "\theap " << i << ": " << heap.usedBytes / MiB << " / " << heap.blockBytes / MiB
+        << " MiB, " << heap.blockCount << " blocks, frag " << heap.fragmentation;
+    if (stats.budgetAvailable) {
+      out << ", driver usage " << heap.processUsage / MiB << " / budget " << heap.budget / MiB
+          << " MiB";
+      if (heap.processUsage > heap.budget) {
+        out << " OVER BUDGET";
+      }
+    } else {
+      out << ", heap size " << heap.heapSize / MiB << " MiB";
+    }
+    out << std::endl;
+  }
+
+  for (size_t i = 0; i < stats.types.size(); i++) {
+    const auto &type = stats.types[i];
+    if (type.blockCount == 0) continue;
+    out << "\ttype " << i << ": " << type.usedBytes / MiB << " / " << type.blockBytes / MiB
+        << " MiB, " << type.allocationCount << " allocations, frag " << type.fragmentation
+        << std::endl;
+  }
+
+  out.flags(flags);
 }
 
-}  // namespace lve
\ No newline at end of file
+}  // namespace lve
@@ -1,8 +1,18 @@
 #pragma once
 
+#include "vke_allocator.hpp"
+#include "vke_defragmenter.hpp"
+#include "vke_deletion_queue.hpp"
+#include "vke_pipeline_cache.hpp"
+#include "vke_pipeline_layout_cache.hpp"
+#include "vke_shader_registry.hpp"
+#include "vke_timeline.hpp"
+#include "vke_uploader.hpp"
 #include "vke_window.hpp"
 
 // std lib headers
+#include <memory>
+#include <ostream>
 #include <string>
 #include <vector>
 
@@ -17,11 +27,27 @@ struct SwapChainSupportDetails {
 struct QueueFamilyIndices {
   uint32_t graphicsFamily;
   uint32_t presentFamily;
+  uint32_t transferFamily;  // dedicated transfer family if there is one, graphics otherwise
   bool graphicsFamilyHasValue = false;
   bool presentFamilyHasValue = false;
+  bool dedicatedTransferFamily = false;
   bool isComplete() { return graphicsFamilyHasValue && presentFamilyHasValue; }
 };
 
+// VK_EXT_extended_dynamic_state entry points, all null when the device doesn't have the extension
+struct VkeExtendedDynamicStateFns {
+  PFN_vkCmdSetCullModeEXT setCullMode = nullptr;
+  PFN_vkCmdSetFrontFaceEXT setFrontFace = nullptr;
+  PFN_vkCmdSetDepthTestEnableEXT setDepthTestEnable = nullptr;
+  PFN_vkCmdSetDepthWriteEnableEXT setDepthWriteEnable = nullptr;
+  PFN_vkCmdSetDepthCompareOpEXT setDepthCompareOp = nullptr;
+
+  bool supported() const {
+    return setCullMode && setFrontFace && setDepthTestEnable && setDepthWriteEnable &&
+           setDepthCompareOp;
+  }
+};
+
 class VkDerkDevice {
  public:
 #ifdef NDEBUG
@@ -30,7 +56,13 @@ class VkDerkDevice {
   const bool enableValidationLayers = true;
 #endif
 
-  VkDerkDevice(VkeWindow &window);
+  // pipeline cache file, relative to the working directory like the shader binaries
+  static constexpr const char *PIPELINE_CACHE_FILE = "pipeline_cache.bin";
+
+  VkDerkDevice(VkeWindow &window) : VkDerkDevice{&window} {}
+  // nullptr: headless, no surface or swap chain extensions (render servers, lavapipe in CI).
+  // Render into a VkeOffscreenRing instead of a VkeSwapChain; presentQueue() is the graphics queue
+  explicit VkDerkDevice(VkeWindow *window);
   ~VkDerkDevice();
 
   // Not copyable or movable
@@ -41,23 +73,38 @@ class VkDerkDevice {
 
   VkCommandPool getCommandPool() { return commandPool; }
   VkDevice device() { return device_; }
-  VkSurfaceKHR surface() { return surface_; }
+  VkSurfaceKHR surface() { return surface_; }  // VK_NULL_HANDLE when headless
+  bool headless() const { return window == nullptr; }
   VkQueue graphicsQueue() { return graphicsQueue_; }
   VkQueue presentQueue() { return presentQueue_; }
+  VkQueue transferQueue() { return transferQueue_; }
+  VkeAllocator &allocator() { return *allocator_; }
+  VkeUploader &uploader() { return *uploader_; }
+  VkeDeletionQueue &deletionQueue() { return *deletionQueue_; }
+  // one timeline semaphore per queue: frames, compute and single time commands on the graphics
+  // queue, uploads on the transfer queue (the uploader is its only submitter)
+  VkeTimeline &graphicsTimeline() { return *graphicsTimeline_; }
+  VkeTimeline &transferTimeline() { return *transferTimeline_; }
+  VkeDefragmenter &defragmenter() { return *defragmenter_; }
+  VkePipelineCache &pipelineCache() { return *pipelineCache_; }
+  VkeShaderRegistry &shaderRegistry() { return *shaderRegistry_; }
+  VkePipelineLayoutCache &pipelineLayoutCache() { return *pipelineLayoutCache_; }
 
   SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(physicalDevice); }
   uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
-  QueueFamilyIndices findPhysicalQueueFamilies() { return findQueueFamilies(physicalDevice); }
+  QueueFamilyIndices findPhysicalQueueFamilies() { return queueFamilyIndices_; }
   VkFormat findSupportedFormat(
       const std::vector<VkFormat> &candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
 
   // Buffer Helper Functions
+  VkBuffer createBufferObject(VkDeviceSize size, VkBufferUsageFlags usage);  // no memory bound
   void createBuffer(
       VkDeviceSize size,
       VkBufferUsageFlags usage,
       VkMemoryPropertyFlags properties,
       VkBuffer &buffer,
-      VkDeviceMemory &bufferMemory);
+      VkeAllocation &bufferAllocation);
+  void destroyBuffer(VkBuffer buffer, VkeAllocation &bufferAllocation);
   VkCommandBuffer beginSingleTimeCommands();
   void endSingleTimeCommands(VkCommandBuffer commandBuffer);
   void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
@@ -68,7 +115,33 @@ class VkDerkDevice {
       const VkImageCreateInfo &imageInfo,
       VkMemoryPropertyFlags properties,
       VkImage &image,
-      VkDeviceMemory &imageMemory);
+      VkeAllocation &imageAllocation);
+  void destroyImage(VkImage image, VkeAllocation &imageAllocation);
+  // `count` identical images sharing one allocation. Only for attachments whose contents never outlive
+  // a render pass, and whose passes are ordered against each other (see the swap chain's depth dependency).
+  void createAliasedImages(
+      const VkImageCreateInfo &imageInfo,
+      uint32_t count,
+      VkMemoryPropertyFlags properties,
+      std::vector<VkImage> &images,
+      VkeAllocation &sharedAllocation);
+  void destroyAliasedImages(std::vector<VkImage> &images, VkeAllocation &sharedAllocation);
+  // true if some memory type allowed by typeBits is lazily allocated (tile memory on mobile GPUs)
+  bool supportsLazilyAllocatedMemory(uint32_t typeBits);
+
+  // Per-heap / per-type accounting of everything allocated through createBuffer/createImageWithInfo,
+  // with driver budget numbers when VK_EXT_memory_budget is available.
+  VkeMemoryStats getMemoryStats();
+  void dumpMemoryStats(std::ostream &out);
+  bool memoryBudgetSupported() { return memoryBudgetSupported_; }
+
+  // cull mode / front face / depth test as dynamic state, see VkePipeline::enableExtendedDynamicState
+  bool extendedDynamicStateSupported() const { return extendedDynamicState_.supported(); }
+  const VkeExtendedDynamicStateFns &extendedDynamicState() const { return extendedDynamicState_; }
+  // VK_EXT_graphics_pipeline_library (+ VK_KHR_pipeline_library) enabled, see VkePipelineLibrary
+  bool graphicsPipelineLibrarySupported() const { return graphicsPipelineLibrarySupported_; }
+  // VK_PRESENT_MODE_FIFO_LATEST_READY_EXT may be used (VK_EXT_present_mode_fifo_latest_ready)
+  bool presentModeFifoLatestReadySupported() const { return presentModeFifoLatestReadySupported_; }
 
   VkPhysicalDeviceProperties properties;
 
@@ -79,27 +152,65 @@ class VkDerkDevice {
   void pickPhysicalDevice();
   void createLogicalDevice();
   void createCommandPool();
+  void createTimelines();
+  void createAllocator();
+  void createUploader();
+  void createDefragmenter();
+  void createPipelineCache();
+  void createShaderRegistry();
+  void createPipelineLayoutCache();
 
   // helper functions
   bool isDeviceSuitable(VkPhysicalDevice device);
   std::vector<const char *> getRequiredExtensions();
+  std::vector<const char *> getRequiredDeviceExtensions();
   bool checkValidationLayerSupport();
   QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device);
   void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT &createInfo);
   void hasGflwRequiredInstanceExtensions();
   bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+  bool isInstanceExtensionAvailable(const char *extensionName);
+  bool isDeviceExtensionAvailable(VkPhysicalDevice device, const char *extensionName);
+  // feature flags of the optional extensions (false when the device doesn't list them) and of 1.2
+  struct SupportedFeatures {
+    bool timelineSemaphore = false;
+    bool extendedDynamicState = false;
+    bool graphicsPipelineLibrary = false;
+    bool presentModeFifoLatestReady = false;
+  };
+  SupportedFeatures querySupportedFeatures(VkPhysicalDevice device);
+  bool supportsTimelineSemaphores(VkPhysicalDevice device);
+  void loadExtendedDynamicStateFns();
   SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
 
   VkInstance instance;
   VkDebugUtilsMessengerEXT debugMessenger;
   VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
-  VkeWindow &window;
+  VkeWindow *window;
   VkCommandPool commandPool;
+  QueueFamilyIndices queueFamilyIndices_;  // resolved once for the picked physical device
 
   VkDevice device_;
-  VkSurfaceKHR surface_;
+  VkSurfaceKHR surface_ = VK_NULL_HANDLE;
   VkQueue graphicsQueue_;
   VkQueue presentQueue_;
+  VkQueue transferQueue_;
+  std::unique_ptr<VkeAllocator> allocator_;
+  std::unique_ptr<VkeUploader> uploader_;
+  std::unique_ptr<VkeDefragmenter> defragmenter_;
+  std::unique_ptr<VkeTimeline> graphicsTimeline_;
+  std::unique_ptr<VkeTimeline> transferTimeline_;
+  std::unique_ptr<VkeDeletionQueue> deletionQueue_;
+  std::unique_ptr<VkePipelineCache> pipelineCache_;
+  std::unique_ptr<VkeShaderRegistry> shaderRegistry_;
+  std::unique_ptr<VkePipelineLayoutCache> pipelineLayoutCache_;
+
+  bool physicalDeviceProperties2Enabled = false;
+  bool memoryBudgetSupported_ = false;
+  PFN_vkGetPhysicalDeviceMemoryProperties2KHR getMemoryProperties2 = nullptr;
+  VkeExtendedDynamicStateFns extendedDynamicState_;
+  bool graphicsPipelineLibrarySupported_ = false;
+  bool presentModeFifoLatestReadySupported_ = false;
 
   const std::vector<const char *> validationLayers = {"VK_LAYER_KHRONOS_validation"};
   const std::vector<const char *> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
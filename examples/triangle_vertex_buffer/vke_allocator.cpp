@@ -0,0 +1,378 @@
+#include "vke_allocator.hpp"
+
+// std headers
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace vke {
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+// *************** Memory Block *********************************
+
+VkeMemoryBlock::VkeMemoryBlock(
+    VkDeviceMemory memory,
+    VkDeviceSize size,
+    uint32_t memoryTypeIndex,
+    VkeResourceKind kind,
+    void *mapped,
+    bool dedicated)
+    : memory{memory},
+      size{size},
+      memoryTypeIndex{memoryTypeIndex},
+      kind{kind},
+      mapped{mapped},
+      dedicated{dedicated} {
+  freeRanges[0] = size;
+}
+
+bool VkeMemoryBlock::allocate(VkDeviceSize allocSize, VkDeviceSize alignment, VkDeviceSize &offset) {
+  for (auto it = freeRanges.begin(); it != freeRanges.end(); ++it) {
+    VkDeviceSize rangeStart = it->first;
+    VkDeviceSize rangeEnd = it->first + it->second;
+    VkDeviceSize alignedStart = alignUp(rangeStart, alignment);
+    if (alignedStart + allocSize > rangeEnd) {
+      continue;
+    }
+
+    // split the range: alignment padding in front stays free, as does any tail
+    freeRanges.erase(it);
+    if (alignedStart > rangeStart) {
+      freeRanges[rangeStart] = alignedStart - rangeStart;
+    }
+    if (alignedStart + allocSize < rangeEnd) {
+      freeRanges[alignedStart + allocSize] = rangeEnd - (alignedStart + allocSize);
+    }
+
+    offset = alignedStart;
+    usedBytes += allocSize;
+    allocationCount++;
+    return true;
+  }
+  return false;
+}
+
+void VkeMemoryBlock::free(VkDeviceSize offset, VkDeviceSize allocSize) {
+  assert(allocationCount > 0 && "freeing from a block with no live allocations");
+
+  VkDeviceSize start = offset;
+  VkDeviceSize end = offset + allocSize;
+
+  // merge with the following free range
+  auto next = freeRanges.lower_bound(start);
+  if (next != freeRanges.end() && next->first == end) {
+    end += next->second;
+    next = freeRanges.erase(next);
+  }
+
+  // merge with the preceding free range
+  if (next != freeRanges.begin()) {
+    auto prev = std::prev(next);
+    if (prev->first + prev->second == start) {
+      start = prev->first;
+      freeRanges.erase(prev);
+    }
+  }
+
+  freeRanges[start] = end - start;
+  usedBytes -= allocSize;
+  allocationCount--;
+}
+
+VkDeviceSize VkeMemoryBlock::largestFreeRange() const {
+  VkDeviceSize largest = 0;
+  for (const auto &range : freeRanges) {
+    largest = std::max(largest, range.second);
+  }
+  return largest;
+}
+
+// *************** Allocator *********************************
+
+VkeAllocator::VkeAllocator(
+    VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize preferredBlockSize)
+    : device{device}, preferredBlockSize{preferredBlockSize} {
+  vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+  pools.resize(memProperties.memoryTypeCount * 2);
+}
+
+VkeAllocator::~VkeAllocator() {
+  for (auto &pool : pools) {
+    for (auto &block : pool.blocks) {
+      if (block->mapped != nullptr) {
+        vkUnmapMemory(device, block->memory);
+      }
+      vkFreeMemory(device, block->memory, nullptr);
+    }
+  }
+}
+
+// largest free range and total free bytes get folded into the fragmentation ratio at the end
+struct FreeSpace {
+  VkDeviceSize largest = 0;
+  VkDeviceSize total = 0;
+};
+
+static void finishUsage(VkeMemoryUsage &usage, const FreeSpace &freeSpace) {
+  usage.fragmentation =
+      freeSpace.total > 0
+          ? 1.0f - static_cast<float>(freeSpace.largest) / static_cast<float>(freeSpace.total)
+          : 0.0f;
+}
+
+static void addBlock(VkeMemoryUsage &usage, FreeSpace &freeSpace, const VkeMemoryBlock &block) {
+  usage.blockBytes += block.size;
+  usage.usedBytes += block.usedBytes;
+  usage.blockCount++;
+  usage.allocationCount += block.allocationCount;
+  if (!block.dedicated) {
+    freeSpace.largest = std::max(freeSpace.largest, block.largestFreeRange());
+    freeSpace.total += block.size - block.usedBytes;
+  }
+}
+
+VkeMemoryStats VkeAllocator::getStats() {
+  std::lock_guard<std::mutex> lock{mutex};
+
+  VkeMemoryStats stats{};
+  stats.types.resize(memProperties.memoryTypeCount);
+  stats.heaps.resize(memProperties.memoryHeapCount);
+  std::vector<FreeSpace> typeFree(memProperties.memoryTypeCount);
+  std::vector<FreeSpace> heapFree(memProperties.memoryHeapCount);
+  FreeSpace totalFree{};
+
+  for (uint32_t i = 0; i < memProperties.memoryHeapCount; i++) {
+    stats.heaps[i].heapSize = memProperties.memoryHeaps[i].size;
+  }
+
+  for (const auto &pool : pools) {
+    for (const auto &block : pool.blocks) {
+      uint32_t heapIndex = memProperties.memoryTypes[block->memoryTypeIndex].heapIndex;
+      addBlock(stats.types[block->memoryTypeIndex], typeFree[block->memoryTypeIndex], *block);
+      addBlock(stats.heaps[heapIndex], heapFree[heapIndex], *block);
+      addBlock(stats.total, totalFree, *block);
+    }
+  }
+
+  for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+    finishUsage(stats.types[i], typeFree[i]);
+  }
+  for (uint32_t i = 0; i < memProperties.memoryHeapCount; i++) {
+    finishUsage(stats.heaps[i], heapFree[i]);
+  }
+  finishUsage(stats.total, totalFree);
+  return stats;
+}
+
+uint32_t VkeAllocator::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
+  for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+    if ((typeFilter & (1 << i)) &&
+        (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+      return i;
+    }
+  }
+
+  throw std::runtime_error("failed to find suitable memory type!");
+}
+
+VkeAllocator::Pool &VkeAllocator::getPool(uint32_t memoryTypeIndex, VkeResourceKind kind) {
+  return pools[memoryTypeIndex * 2 + static_cast<uint32_t>(kind)];
+}
+
+// Small heaps (integrated GPUs, the 256 MiB BAR heap) get smaller blocks so one block can't eat
+// most of the heap.
+VkDeviceSize VkeAllocator::blockSizeFor(uint32_t memoryTypeIndex) const {
+  uint32_t heapIndex = memProperties.memoryTypes[memoryTypeIndex].heapIndex;
+  VkDeviceSize heapSize = memProperties.memoryHeaps[heapIndex].size;
+  if (heapSize <= SMALL_HEAP_MAX_SIZE) {
+    return std::min(preferredBlockSize, heapSize / 8);
+  }
+  return preferredBlockSize;
+}
+
+VkeMemoryBlock *VkeAllocator::createBlock(
+    uint32_t memoryTypeIndex, VkDeviceSize size, VkeResourceKind kind, bool dedicated) {
+  VkMemoryAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocInfo.allocationSize = size;
+  allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+  VkDeviceMemory memory;
+  if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+    throw std::runtime_error("failed to allocate device memory block!");
+  }
+
+  // host visible blocks are mapped once and stay mapped, sub-allocations just offset the pointer
+  void *mapped = nullptr;
+  if (memProperties.memoryTypes[memoryTypeIndex].propertyFlags &
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+    if (vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, &mapped) != VK_SUCCESS) {
+      vkFreeMemory(device, memory, nullptr);
+      throw std::runtime_error("failed to map device memory block!");
+    }
+  }
+
+  auto &pool = getPool(memoryTypeIndex, kind);
+  pool.blocks.push_back(
+      std::make_unique<VkeMemoryBlock>(memory, size, memoryTypeIndex, kind, mapped, dedicated));
+  return pool.blocks.back().get();
+}
+
+void VkeAllocator::destroyBlock(VkeMemoryBlock *block) {
+  if (block->mapped != nullptr) {
+    vkUnmapMemory(device, block->memory);
+  }
+  vkFreeMemory(device, block->memory, nullptr);
+
+  auto &blocks = getPool(block->memoryTypeIndex, block->kind).blocks;
+  blocks.erase(std::find_if(blocks.begin(), blocks.end(), [block](const auto &b) {
+    return b.get() == block;
+  }));
+}
+
+VkeAllocation VkeAllocator::allocate(
+    const VkMemoryRequirements &requirements,
+    VkMemoryPropertyFlags properties,
+    VkeResourceKind kind) {
+  std::lock_guard<std::mutex> lock{mutex};
+
+  uint32_t memoryTypeIndex = findMemoryType(requirements.memoryTypeBits, properties);
+  VkDeviceSize blockSize = blockSizeFor(memoryTypeIndex);
+
+  VkeMemoryBlock *block = nullptr;
+  VkDeviceSize offset = 0;
+
+  // lazily allocated memory is only committed by the driver as tiles touch it; sharing a block with
+  // other resources would gain nothing, so transient attachments always get their own
+  bool lazy = (memProperties.memoryTypes[memoryTypeIndex].propertyFlags &
+               VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) != 0;
+  if (requirements.size > blockSize / 2 || lazy) {
+    block = createBlock(memoryTypeIndex, requirements.size, kind, true);
+    block->allocate(requirements.size, requirements.alignment, offset);
+  } else {
+    for (auto &candidate : getPool(memoryTypeIndex, kind).blocks) {
+      if (!candidate->dedicated &&
+          candidate->allocate(requirements.size, requirements.alignment, offset)) {
+        block = candidate.get();
+        break;
+      }
+    }
+    if (block == nullptr) {
+      block = createBlock(memoryTypeIndex, blockSize, kind, false);
+      block->allocate(requirements.size, requirements.alignment, offset);
+    }
+  }
+
+  return makeAllocation(block, offset, requirements.size);
+}
+
+VkeAllocation VkeAllocator::makeAllocation(
+    VkeMemoryBlock *block, VkDeviceSize offset, VkDeviceSize size) {
+  VkeAllocation allocation{};
+  allocation.memory = block->memory;
+  allocation.offset = offset;
+  allocation.size = size;
+  allocation.memoryTypeIndex = block->memoryTypeIndex;
+  allocation.mapped =
+      block->mapped != nullptr ? static_cast<char *>(block->mapped) + offset : nullptr;
+  allocation.block = block;
+  return allocation;
+}
+
+VkeDefragmentationPlan VkeAllocator::planDefragmentation(
+    const std::unordered_map<const VkeMemoryBlock *, VkDeviceSize> &movableBytes) {
+  std::lock_guard<std::mutex> lock{mutex};
+
+  auto movable = [&](const VkeMemoryBlock *block) {
+    auto it = movableBytes.find(block);
+    return it != movableBytes.end() ? it->second : 0;
+  };
+  // only a block holding nothing but movable allocations is freed by emptying it, anything
+  // pinned (mesh pool, frame ring, staging, images) would keep it alive
+  auto isCandidate = [&](const VkeMemoryBlock *block) {
+    return !block->dedicated && !block->empty() && movable(block) == block->usedBytes;
+  };
+
+  VkeDefragmentationPlan best;
+  for (auto &pool : pools) {
+    VkeMemoryBlock *source = nullptr;
+    for (auto &block : pool.blocks) {
+      if (isCandidate(block.get()) &&
+          (source == nullptr || block->usedBytes < source->usedBytes)) {
+        source = block.get();
+      }
+    }
+    if (source == nullptr) continue;
+
+    // targets never become sources and are never emptier than the source, so buffers only ever
+    // move towards fuller, pinned blocks and a later step can't move them back
+    std::vector<const VkeMemoryBlock *> targets;
+    VkDeviceSize targetFree = 0;
+    for (auto &block : pool.blocks) {
+      if (block->dedicated || block->empty() || isCandidate(block.get())) continue;
+      if (block->usedBytes < source->usedBytes) continue;
+      targets.push_back(block.get());
+      targetFree += block->size - block->usedBytes;
+    }
+
+    // moves that can't empty the source wouldn't reduce the live block count: start none
+    if (source->usedBytes > targetFree) continue;
+
+    float occupancy = static_cast<float>(source->usedBytes) / source->size;
+    if (best.source == nullptr ||
+        occupancy < static_cast<float>(best.source->usedBytes) / best.source->size) {
+      best.source = source;
+      best.targets = std::move(targets);
+    }
+  }
+  return best;
+}
+
+VkeAllocation VkeAllocator::allocateInExistingBlocks(
+    const VkMemoryRequirements &requirements,
+    uint32_t memoryTypeIndex,
+    VkeResourceKind kind,
+    const std::vector<const VkeMemoryBlock *> &targets) {
+  std::lock_guard<std::mutex> lock{mutex};
+
+  if (!(requirements.memoryTypeBits & (1u << memoryTypeIndex))) {
+    return VkeAllocation{};
+  }
+
+  VkDeviceSize offset = 0;
+  for (auto &block : getPool(memoryTypeIndex, kind).blocks) {
+    if (std::find(targets.begin(), targets.end(), block.get()) == targets.end()) continue;
+    if (block->allocate(requirements.size, requirements.alignment, offset)) {
+      return makeAllocation(block.get(), offset, requirements.size);
+    }
+  }
+  return VkeAllocation{};
+}
+
+void VkeAllocator::free(VkeAllocation &allocation) {
+  if (!allocation.isValid()) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock{mutex};
+
+  VkeMemoryBlock *block = allocation.block;
+  block->free(allocation.offset, allocation.size);
+
+  // keep one empty block per pool around so load/unload cycles don't thrash vkAllocateMemory
+  if (block->empty()) {
+    auto &blocks = getPool(block->memoryTypeIndex, block->kind).blocks;
+    size_t emptyBlocks = std::count_if(blocks.begin(), blocks.end(), [](const auto &b) {
+      return !b->dedicated && b->empty();
+    });
+    if (block->dedicated || emptyBlocks > 1) {
+      destroyBlock(block);
+    }
+  }
+
+  allocation = VkeAllocation{};
+}
+
+}  // namespace vke
@@ -0,0 +1,156 @@
+#pragma once
+
+// vulkan headers
+#include <vulkan/vulkan.h>
+
+// std lib headers
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace vke {
+
+class VkeMemoryBlock;
+
+// Handle to a sub-range of a VkDeviceMemory block. This is what buffers and images hold on to
+// instead of a raw VkDeviceMemory: bind with (memory, offset) and give it back to the allocator.
+struct VkeAllocation {
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  VkDeviceSize offset = 0;
+  VkDeviceSize size = 0;
+  uint32_t memoryTypeIndex = 0;
+  void *mapped = nullptr;  // host visible memory stays mapped for the block's lifetime
+  VkeMemoryBlock *block = nullptr;
+
+  bool isValid() const { return memory != VK_NULL_HANDLE; }
+};
+
+// Buffers/linear images and optimal images never share a block, which keeps every block free of
+// bufferImageGranularity conflicts without having to pad neighbouring allocations.
+enum class VkeResourceKind { Linear = 0, Optimal = 1 };
+
+// Accounting for one memory type or heap. fragmentation is 1 - largest free range / total free
+// bytes: 0 means all free space is one range, close to 1 means it's scattered in small holes.
+struct VkeMemoryUsage {
+  VkDeviceSize blockBytes = 0;  // bytes allocated from the driver
+  VkDeviceSize usedBytes = 0;   // bytes handed out to buffers and images
+  uint32_t blockCount = 0;
+  uint32_t allocationCount = 0;
+  float fragmentation = 0.0f;
+};
+
+struct VkeHeapUsage : VkeMemoryUsage {
+  VkDeviceSize heapSize = 0;
+  VkDeviceSize budget = 0;       // VK_EXT_memory_budget, 0 when unavailable
+  VkDeviceSize processUsage = 0; // what the driver thinks this process uses on the heap
+};
+
+struct VkeMemoryStats {
+  std::vector<VkeMemoryUsage> types;
+  std::vector<VkeHeapUsage> heaps;
+  VkeMemoryUsage total;
+  bool budgetAvailable = false;
+};
+
+// One VkDeviceMemory allocation carved up with a first-fit free list (offset -> size).
+// Adjacent free ranges are merged on free so the list stays short.
+class VkeMemoryBlock {
+ public:
+  VkeMemoryBlock(
+      VkDeviceMemory memory,
+      VkDeviceSize size,
+      uint32_t memoryTypeIndex,
+      VkeResourceKind kind,
+      void *mapped,
+      bool dedicated);
+
+  bool allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize &offset);
+  void free(VkDeviceSize offset, VkDeviceSize size);
+
+  bool empty() const { return allocationCount == 0; }
+  VkDeviceSize largestFreeRange() const;
+
+  VkDeviceMemory memory;
+  VkDeviceSize size;
+  uint32_t memoryTypeIndex;
+  VkeResourceKind kind;
+  void *mapped;
+  bool dedicated;
+
+  VkDeviceSize usedBytes = 0;
+  uint32_t allocationCount = 0;
+
+ private:
+  std::map<VkDeviceSize, VkDeviceSize> freeRanges;
+};
+
+// One defragmentation batch: source holds nothing but movable allocations, so draining it frees
+// the block; targets are the blocks of its pool the buffers may move into.
+struct VkeDefragmentationPlan {
+  VkeMemoryBlock *source = nullptr;
+  std::vector<const VkeMemoryBlock *> targets;
+};
+
+// Sub-allocating device memory allocator: one pool per (memory type, resource kind), each pool a
+// list of large blocks. Requests bigger than half a block get a dedicated VkDeviceMemory.
+class VkeAllocator {
+ public:
+  static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 64ull * 1024 * 1024;
+  static constexpr VkDeviceSize SMALL_HEAP_MAX_SIZE = 1024ull * 1024 * 1024;
+
+  VkeAllocator(
+      VkPhysicalDevice physicalDevice,
+      VkDevice device,
+      VkDeviceSize preferredBlockSize = DEFAULT_BLOCK_SIZE);
+  ~VkeAllocator();
+
+  VkeAllocator(const VkeAllocator &) = delete;
+  VkeAllocator &operator=(const VkeAllocator &) = delete;
+
+  VkeAllocation allocate(
+      const VkMemoryRequirements &requirements,
+      VkMemoryPropertyFlags properties,
+      VkeResourceKind kind);
+  void free(VkeAllocation &allocation);
+
+  // Defragmentation support. movableBytes is what the caller can relocate per block, in allocation
+  // sizes. The plan picks the least occupied block whose allocations are all movable and fit in the
+  // free space of the pool's pinned blocks that are at least as full; no source if none qualifies.
+  // allocateInExistingBlocks never opens a new block and only uses the given blocks.
+  VkeDefragmentationPlan planDefragmentation(
+      const std::unordered_map<const VkeMemoryBlock *, VkDeviceSize> &movableBytes);
+  VkeAllocation allocateInExistingBlocks(
+      const VkMemoryRequirements &requirements,
+      uint32_t memoryTypeIndex,
+      VkeResourceKind kind,
+      const std::vector<const VkeMemoryBlock *> &targets);
+
+  // fills types, heaps (minus budget) and total
+  VkeMemoryStats getStats();
+
+  uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+  const VkPhysicalDeviceMemoryProperties &memoryProperties() const { return memProperties; }
+
+ private:
+  struct Pool {
+    std::vector<std::unique_ptr<VkeMemoryBlock>> blocks;
+  };
+
+  Pool &getPool(uint32_t memoryTypeIndex, VkeResourceKind kind);
+  VkDeviceSize blockSizeFor(uint32_t memoryTypeIndex) const;
+  VkeMemoryBlock *createBlock(
+      uint32_t memoryTypeIndex, VkDeviceSize size, VkeResourceKind kind, bool dedicated);
+  void destroyBlock(VkeMemoryBlock *block);
+  VkeAllocation makeAllocation(VkeMemoryBlock *block, VkDeviceSize offset, VkDeviceSize size);
+
+  VkDevice device;
+  VkPhysicalDeviceMemoryProperties memProperties;
+  VkDeviceSize preferredBlockSize;
+
+  std::vector<Pool> pools;  // indexed by memoryTypeIndex * 2 + kind
+  std::mutex mutex;
+};
+
+}  // namespace vke
@@ -0,0 +1,110 @@
+#include "vke_compute_pipeline.hpp"
+
+// std headers
+#include <cassert>
+#include <stdexcept>
+#include <utility>
+
+namespace vke {
+
+VkeComputePipeline::VkeComputePipeline(
+    VkDerkDevice &device,
+    const std::string &compFilepath,
+    const VkeSpecializationConstants &specialization)
+    : VkeComputePipeline{device, device.shaderRegistry().load(compFilepath), specialization} {}
+
+VkeComputePipeline::VkeComputePipeline(
+    VkDerkDevice &device, VkeSpirvSpan compCode, const VkeSpecializationConstants &specialization)
+    : VkeComputePipeline{device, device.shaderRegistry().get(compCode), specialization} {}
+
+VkeComputePipeline::VkeComputePipeline(
+    VkDerkDevice &device,
+    VkeShaderRegistry::Handle compShader,
+    const VkeSpecializationConstants &specialization)
+    : device{device}, shader{std::move(compShader)} {
+  if (shader->reflection().stage() != VK_SHADER_STAGE_COMPUTE_BIT) {
+    throw std::runtime_error("compute pipeline needs a compute shader");
+  }
+  createComputePipeline(specialization);
+}
+
+VkeComputePipeline::~VkeComputePipeline() {
+  vkDestroyPipeline(device.device(), pipeline, nullptr);
+}
+
+void VkeComputePipeline::createComputePipeline(const VkeSpecializationConstants &specialization) {
+  const VkeShaderReflection &reflection = shader->reflection();
+  VkePipelineLayoutDescription layoutDescription = VkePipelineLayoutDescription::merge({&reflection});
+  pipelineLayout = device.pipelineLayoutCache().get(layoutDescription);
+  setLayouts = device.pipelineLayoutCache().setLayouts(layoutDescription);
+
+  // a local_size_x_id dimension takes the specialized value instead of the default
+  for (int i = 0; i < 3; i++) {
+    localSize_[i] = reflection.localSize()[i];
+    auto it = specialization.values().find(reflection.localSizeSpecIds()[i]);
+    if (it != specialization.values().end()) {
+      localSize_[i] = it->second.bits;
+    }
+  }
+
+  VkSpecializationInfo specializationInfo{};
+  std::vector<VkSpecializationMapEntry> specializationEntries;
+  std::vector<uint32_t> specializationData;
+
+  VkPipelineShaderStageCreateInfo stage{};
+  stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  stage.module = shader->handle();
+  stage.pName = "main";
+  if (!specialization.empty()) {
+    specialization.fill(specializationInfo, specializationEntries, specializationData);
+    stage.pSpecializationInfo = &specializationInfo;
+  }
+
+  VkComputePipelineCreateInfo pipelineInfo{};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  pipelineInfo.stage = stage;
+  pipelineInfo.layout = pipelineLayout;
+  pipelineInfo.basePipelineIndex = -1;
+
+  if (vkCreateComputePipelines(
+          device.device(), device.pipelineCache().handle(), 1, &pipelineInfo, nullptr, &pipeline) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create compute pipeline!");
+  }
+}
+
+void VkeComputePipeline::bind(VkCommandBuffer commandBuffer) {
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+}
+
+void VkeComputePipeline::pushConstants(
+    VkCommandBuffer commandBuffer, const void *data, uint32_t size, uint32_t offset) {
+  VkPushConstantRange range = shader->reflection().pushConstantRange();
+  assert(offset + size <= range.offset + range.size && "push constants outside the shader's block");
+  vkCmdPushConstants(commandBuffer, pipelineLayout, range.stageFlags, offset, size, data);
+}
+
+std::array<uint32_t, 3> VkeComputePipeline::groupCount(uint32_t x, uint32_t y, uint32_t z) const {
+  auto groups = [](uint32_t invocations, uint32_t size) {
+    return invocations / size + (invocations % size != 0 ? 1 : 0);  // no overflow near UINT32_MAX
+  };
+  return {groups(x, localSize_[0]), groups(y, localSize_[1]), groups(z, localSize_[2])};
+}
+
+void VkeComputePipeline::dispatch(
+    VkCommandBuffer commandBuffer, uint32_t groupsX, uint32_t groupsY, uint32_t groupsZ) {
+  const uint32_t *maxGroups = device.properties.limits.maxComputeWorkGroupCount;
+  if (groupsX > maxGroups[0] || groupsY > maxGroups[1] || groupsZ > maxGroups[2]) {
+    throw std::runtime_error("compute dispatch exceeds maxComputeWorkGroupCount");
+  }
+  vkCmdDispatch(commandBuffer, groupsX, groupsY, groupsZ);
+}
+
+void VkeComputePipeline::dispatchInvocations(
+    VkCommandBuffer commandBuffer, uint32_t x, uint32_t y, uint32_t z) {
+  std::array<uint32_t, 3> groups = groupCount(x, y, z);
+  dispatch(commandBuffer, groups[0], groups[1], groups[2]);
+}
+
+}  // namespace vke
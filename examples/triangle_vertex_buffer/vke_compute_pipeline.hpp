@@ -0,0 +1,70 @@
+#pragma once
+
+#include "vke_pipeline.hpp"
+
+// std lib headers
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace vke {
+
+// Compute counterpart of VkePipeline: one compute shader, its module from the device shader
+// registry, compiled through the device pipeline cache. The pipeline layout (descriptor sets, push
+// constants) is reflected from the shader and shared through the device pipeline layout cache, so
+// a compute pass and a graphics pass declaring the same bindings use the same set layouts.
+//
+// The workgroup size comes from the shader's local_size; dispatchInvocations turns a thread count
+// into group counts with it (local_size_x_id constants set in `specialization` are honoured).
+class VkeComputePipeline {
+ public:
+  VkeComputePipeline(
+      VkDerkDevice &device,
+      const std::string &compFilepath,
+      const VkeSpecializationConstants &specialization = {});
+  // SPIR-V already in memory (build time embedded shaders)
+  VkeComputePipeline(
+      VkDerkDevice &device,
+      VkeSpirvSpan compCode,
+      const VkeSpecializationConstants &specialization = {});
+  VkeComputePipeline(
+      VkDerkDevice &device,
+      VkeShaderRegistry::Handle compShader,
+      const VkeSpecializationConstants &specialization = {});
+  ~VkeComputePipeline();
+
+  VkeComputePipeline(const VkeComputePipeline &) = delete;
+  VkeComputePipeline &operator=(const VkeComputePipeline &) = delete;
+
+  VkPipeline handle() const { return pipeline; }
+  // owned by the device's pipeline layout cache
+  VkPipelineLayout layout() const { return pipelineLayout; }
+  // set layouts of layout(), index = set number, for allocating descriptor sets
+  const std::vector<VkDescriptorSetLayout> &descriptorSetLayouts() const { return setLayouts; }
+  const VkeShaderReflection &reflection() const { return shader->reflection(); }
+  // workgroup size after specialization
+  const std::array<uint32_t, 3> &localSize() const { return localSize_; }
+
+  void bind(VkCommandBuffer commandBuffer);
+  // stage flags come from the reflected push constant range
+  void pushConstants(VkCommandBuffer commandBuffer, const void *data, uint32_t size, uint32_t offset = 0);
+
+  // workgroups needed to cover x * y * z invocations, rounded up per dimension
+  std::array<uint32_t, 3> groupCount(uint32_t x, uint32_t y = 1, uint32_t z = 1) const;
+  void dispatch(VkCommandBuffer commandBuffer, uint32_t groupsX, uint32_t groupsY = 1, uint32_t groupsZ = 1);
+  // one invocation per element; the shader must skip the invocations past the end of the last group
+  void dispatchInvocations(VkCommandBuffer commandBuffer, uint32_t x, uint32_t y = 1, uint32_t z = 1);
+
+ private:
+  void createComputePipeline(const VkeSpecializationConstants &specialization);
+
+  VkDerkDevice &device;
+  VkeShaderRegistry::Handle shader;
+  VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+  std::vector<VkDescriptorSetLayout> setLayouts;
+  std::array<uint32_t, 3> localSize_{1, 1, 1};
+  VkPipeline pipeline = VK_NULL_HANDLE;
+};
+
+}  // namespace vke
@@ -0,0 +1,171 @@
+#include "vke_defragmenter.hpp"
+
+#include "vk_derk_device.hpp"
+
+// std headers
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+namespace vke {
+
+VkeDefragmenter::VkeDefragmenter(VkDerkDevice &device, VkDeviceSize bytesPerStep)
+    : device{device}, bytesPerStep{bytesPerStep} {}
+
+VkeDefragmenter::~VkeDefragmenter() {
+  // owners keep their original buffers, moves that never completed are thrown away
+  for (auto &kv : entries) {
+    Entry &entry = kv.second;
+    if (entry.moving) {
+      device.uploader().wait(entry.ticket);
+      device.destroyBuffer(entry.newBuffer, entry.newAllocation);
+    }
+  }
+}
+
+VkeDefragmenter::Handle VkeDefragmenter::registerBuffer(
+    VkBuffer *buffer,
+    VkeAllocation *allocation,
+    VkDeviceSize size,
+    VkBufferUsageFlags usage,
+    std::function<void()> onMoved) {
+  assert((usage & VK_BUFFER_USAGE_TRANSFER_SRC_BIT) && "movable buffers must be transfer sources");
+
+  std::lock_guard<std::mutex> lock{mutex};
+  Entry entry{};
+  entry.buffer = buffer;
+  entry.allocation = allocation;
+  entry.size = size;
+  entry.usage = usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT;  // the replacement is a copy target
+  entry.onMoved = std::move(onMoved);
+
+  Handle handle = nextHandle++;
+  entries.emplace(handle, std::move(entry));
+  return handle;
+}
+
+void VkeDefragmenter::unregisterBuffer(Handle handle) {
+  std::lock_guard<std::mutex> lock{mutex};
+  auto it = entries.find(handle);
+  if (it == entries.end()) {
+    return;
+  }
+
+  // the copy may still be reading the owner's buffer: let it finish, then drop the replacement
+  Entry &entry = it->second;
+  if (entry.moving) {
+    device.uploader().wait(entry.ticket);
+    device.destroyBuffer(entry.newBuffer, entry.newAllocation);
+  }
+  entries.erase(it);
+}
+
+void VkeDefragmenter::step() {
+  std::lock_guard<std::mutex> lock{mutex};
+  finishMoves();
+  startMoves();
+}
+
+void VkeDefragmenter::finishMoves() {
+  for (auto &kv : entries) {
+    Entry &entry = kv.second;
+    if (entry.moving && device.uploader().isComplete(entry.ticket)) {
+      completeMove(entry);
+    }
+  }
+}
+
+void VkeDefragmenter::startMoves() {
+  // one batch at a time: don't pick a new source block while copies out of the last one are running
+  for (auto &kv : entries) {
+    if (kv.second.moving) {
+      return;
+    }
+  }
+
+  // allocation sizes, the unit the allocator's usedBytes counts in: a block is only worth draining
+  // when every byte in it is ours to move
+  std::unordered_map<const VkeMemoryBlock *, VkDeviceSize> movableBytes;
+  for (auto &kv : entries) {
+    movableBytes[kv.second.allocation->block] += kv.second.allocation->size;
+  }
+  VkeDefragmentationPlan plan = device.allocator().planDefragmentation(movableBytes);
+  if (plan.source == nullptr) {
+    return;
+  }
+
+  VkDeviceSize bytesMoved = 0;
+  for (auto &kv : entries) {
+    Entry &entry = kv.second;
+    if (bytesMoved >= bytesPerStep) {
+      break;
+    }
+    if (entry.allocation->block != plan.source) {
+      continue;
+    }
+    if (!startMove(entry, plan.targets)) {
+      break;  // other blocks are out of suitable holes, try again next step
+    }
+    bytesMoved += entry.size;
+  }
+
+  device.uploader().flush();
+}
+
+bool VkeDefragmenter::startMove(
+    Entry &entry, const std::vector<const VkeMemoryBlock *> &targets) {
+  VkBuffer newBuffer = device.createBufferObject(entry.size, entry.usage);
+
+  VkMemoryRequirements memRequirements;
+  vkGetBufferMemoryRequirements(device.device(), newBuffer, &memRequirements);
+
+  VkeAllocation newAllocation = device.allocator().allocateInExistingBlocks(
+      memRequirements,
+      entry.allocation->memoryTypeIndex,
+      VkeResourceKind::Linear,
+      targets);
+  if (!newAllocation.isValid()) {
+    vkDestroyBuffer(device.device(), newBuffer, nullptr);
+    return false;
+  }
+
+  if (vkBindBufferMemory(device.device(), newBuffer, newAllocation.memory, newAllocation.offset) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to bind defragmented buffer memory!");
+  }
+
+  entry.newBuffer = newBuffer;
+  entry.newAllocation = newAllocation;
+
+  // host visible memory is copied on the spot, everything else by the GPU on the transfer queue
+  if (entry.allocation->mapped != nullptr && newAllocation.mapped != nullptr) {
+    memcpy(newAllocation.mapped, entry.allocation->mapped, static_cast<size_t>(entry.size));
+    completeMove(entry);
+  } else {
+    entry.ticket = device.uploader().copyBuffer(*entry.buffer, newBuffer, entry.size);
+    entry.moving = true;
+  }
+  return true;
+}
+
+void VkeDefragmenter::completeMove(Entry &entry) {
+  // frames already submitted may still read the old buffer, so it dies with the deletion queue
+  VkBuffer oldBuffer = *entry.buffer;
+  VkeAllocation oldAllocation = *entry.allocation;
+  VkDerkDevice &dev = device;
+  device.deletionQueue().push([&dev, oldBuffer, oldAllocation]() mutable {
+    dev.destroyBuffer(oldBuffer, oldAllocation);
+  });
+
+  *entry.buffer = entry.newBuffer;
+  *entry.allocation = entry.newAllocation;
+  entry.newBuffer = VK_NULL_HANDLE;
+  entry.newAllocation = VkeAllocation{};
+  entry.moving = false;
+
+  if (entry.onMoved) {
+    entry.onMoved();
+  }
+}
+
+}  // namespace vke
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "vke_allocator.hpp"
+#include "vke_uploader.hpp"
+
+// vulkan headers
+#include <vulkan/vulkan.h>
+
+// std lib headers
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace vke {
+
+class VkDerkDevice;
+
+// Incremental compaction of buffer memory. Owners register the (buffer, allocation) pair they hold;
+// each step() picks the emptiest block that holds nothing but registered buffers, so draining it
+// actually frees it, and moves them into holes of fuller blocks that also hold unmovable memory
+// (GPU copy on the transfer queue, memcpy for host visible memory) within a byte budget. Once a
+// copy has landed the owner's handles are rewritten in place. The old buffer goes through the
+// device deletion queue, so frames still in flight keep reading valid memory, and the emptied block
+// is handed back to the driver by the allocator. Nothing is moved unless the whole block fits.
+//
+// Registered buffers must have been created with VK_BUFFER_USAGE_TRANSFER_SRC_BIT. Images are not
+// moved: their layout and tiling would need per-image copy paths, and our only images (depth) are
+// recreated with the swap chain anyway.
+class VkeDefragmenter {
+ public:
+  using Handle = uint64_t;
+  static constexpr VkDeviceSize DEFAULT_BYTES_PER_STEP = 8ull * 1024 * 1024;
+
+  VkeDefragmenter(VkDerkDevice &device, VkDeviceSize bytesPerStep = DEFAULT_BYTES_PER_STEP);
+  ~VkeDefragmenter();
+
+  VkeDefragmenter(const VkeDefragmenter &) = delete;
+  VkeDefragmenter &operator=(const VkeDefragmenter &) = delete;
+
+  // buffer/allocation must stay at the same address until unregistered. onMoved runs after the
+  // handles have been patched, for owners that cache derived state.
+  Handle registerBuffer(
+      VkBuffer *buffer,
+      VkeAllocation *allocation,
+      VkDeviceSize size,
+      VkBufferUsageFlags usage,
+      std::function<void()> onMoved = nullptr);
+  // waits for an in-flight move of this buffer, so the owner can destroy it right after
+  void unregisterBuffer(Handle handle);
+
+  // once per frame, after submitting
+  void step();
+
+  void setBytesPerStep(VkDeviceSize bytes) { bytesPerStep = bytes; }
+
+ private:
+  struct Entry {
+    VkBuffer *buffer;
+    VkeAllocation *allocation;
+    VkDeviceSize size;
+    VkBufferUsageFlags usage;
+    std::function<void()> onMoved;
+
+    // pending move
+    bool moving = false;
+    VkBuffer newBuffer = VK_NULL_HANDLE;
+    VkeAllocation newAllocation{};
+    VkeUploadTicket ticket = 0;
+  };
+
+  void finishMoves();
+  void startMoves();
+  bool startMove(Entry &entry, const std::vector<const VkeMemoryBlock *> &targets);
+  void completeMove(Entry &entry);
+
+  VkDerkDevice &device;
+  VkDeviceSize bytesPerStep;
+
+  std::unordered_map<Handle, Entry> entries;
+  Handle nextHandle = 1;
+  std::mutex mutex;
+};
+
+}  // namespace vke
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "vke_timeline.hpp"
+
+// std lib headers
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <utility>
+
+namespace vke {
+
+// Deferred destruction for objects that work already submitted to the GPU may still use.
+// Serials are values of the graphics queue's timeline: a pushed destructor runs once the
+// submission that was last made at push time has completed.
+class VkeDeletionQueue {
+ public:
+  explicit VkeDeletionQueue(VkeTimeline &timeline) : timeline{timeline} {}
+
+  VkeDeletionQueue(const VkeDeletionQueue &) = delete;
+  VkeDeletionQueue &operator=(const VkeDeletionQueue &) = delete;
+
+  void push(std::function<void()> destroy) {
+    uint64_t serial = timeline.lastSubmitted();
+    std::lock_guard<std::mutex> lock{mutex};
+    entries.emplace_back(serial, std::move(destroy));
+  }
+
+  // runs whatever the GPU is done with, never blocks
+  void collect() { collect(timeline.completed()); }
+
+  // serials complete in order on the graphics queue, so the front of the queue retires first
+  void collect(uint64_t completedSerial) {
+    std::deque<std::function<void()>> ready;
+    {
+      std::lock_guard<std::mutex> lock{mutex};
+      while (!entries.empty() && entries.front().first <= completedSerial) {
+        ready.push_back(std::move(entries.front().second));
+        entries.pop_front();
+      }
+    }
+    for (auto &destroy : ready) {
+      destroy();
+    }
+  }
+
+  // only once the device is idle
+  void flush() { collect(UINT64_MAX); }
+
+  uint64_t lastSubmittedSerial() { return timeline.lastSubmitted(); }
+
+  // for owners that retire their own resources (ranges, slots) against the same serials
+  uint64_t completedSerial() { return timeline.completed(); }
+
+ private:
+  VkeTimeline &timeline;
+  std::deque<std::pair<uint64_t, std::function<void()>>> entries;
+  std::mutex mutex;
+};
+
+}  // namespace vke
@@ -0,0 +1,53 @@
+#include "vke_frame_ring.hpp"
+
+// std headers
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace vke {
+
+VkeFrameRing::VkeFrameRing(VkDerkDevice &device, VkDeviceSize bytesPerFrame, uint32_t frameCount)
+    : device{device}, bytesPerFrame{bytesPerFrame}, frameCount{frameCount} {
+  uniformAlignment =
+      std::max<VkDeviceSize>(device.properties.limits.minUniformBufferOffsetAlignment, 1);
+  storageAlignment =
+      std::max<VkDeviceSize>(device.properties.limits.minStorageBufferOffsetAlignment, 1);
+
+  // keep every frame region aligned for any kind of binding
+  VkDeviceSize regionAlignment = std::max({uniformAlignment, storageAlignment, VERTEX_ALIGNMENT});
+  this->bytesPerFrame = (bytesPerFrame + regionAlignment - 1) / regionAlignment * regionAlignment;
+
+  // mapped once by the allocator and never unmapped, so nothing maps in the frame loop
+  device.createBuffer(
+      this->bytesPerFrame * frameCount,
+      VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+          VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+      buffer,
+      bufferAllocation);
+}
+
+VkeFrameRing::~VkeFrameRing() { device.destroyBuffer(buffer, bufferAllocation); }
+
+void VkeFrameRing::beginFrame(size_t frameIndex) {
+  assert(frameIndex < frameCount && "frame index out of range for frame ring");
+  frameBase = bytesPerFrame * frameIndex;
+  head = frameBase;
+}
+
+VkeFrameAllocation VkeFrameRing::allocate(VkDeviceSize size, VkDeviceSize alignment) {
+  VkDeviceSize offset = (head + alignment - 1) / alignment * alignment;
+  if (offset + size > frameBase + bytesPerFrame) {
+    throw std::runtime_error("frame ring out of space for this frame!");
+  }
+  head = offset + size;
+
+  VkeFrameAllocation allocation{};
+  allocation.buffer = buffer;
+  allocation.offset = offset;
+  allocation.data = static_cast<char *>(bufferAllocation.mapped) + offset;
+  return allocation;
+}
+
+}  // namespace vke
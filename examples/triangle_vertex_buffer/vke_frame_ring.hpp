@@ -0,0 +1,63 @@
+#pragma once
+
+#include "vk_derk_device.hpp"
+
+// std lib headers
+#include <cstring>
+
+namespace vke {
+
+// Where a per-frame allocation lives: bind `buffer` at `offset` and write through `data`.
+struct VkeFrameAllocation {
+  VkBuffer buffer = VK_NULL_HANDLE;
+  VkDeviceSize offset = 0;
+  void *data = nullptr;
+};
+
+// Linear allocator for CPU -> GPU data that only lives for one frame (uniforms, transient vertices,
+// push constant data that doesn't fit in maxPushConstantsSize). One persistently mapped buffer is
+// split into a region per frame in flight; a region is rewound in beginFrame, which must only be
+// called once the swap chain has waited on that frame's timeline value (i.e. after acquireNextImage).
+class VkeFrameRing {
+ public:
+  VkeFrameRing(VkDerkDevice &device, VkDeviceSize bytesPerFrame, uint32_t frameCount);
+  ~VkeFrameRing();
+
+  VkeFrameRing(const VkeFrameRing &) = delete;
+  VkeFrameRing &operator=(const VkeFrameRing &) = delete;
+
+  void beginFrame(size_t frameIndex);
+
+  VkeFrameAllocation allocate(VkDeviceSize size, VkDeviceSize alignment);
+  VkeFrameAllocation allocateUniform(VkDeviceSize size) { return allocate(size, uniformAlignment); }
+  VkeFrameAllocation allocateStorage(VkDeviceSize size) { return allocate(size, storageAlignment); }
+  VkeFrameAllocation allocateVertex(VkDeviceSize size) { return allocate(size, VERTEX_ALIGNMENT); }
+
+  // copy a value in and hand back where it landed
+  template <typename T>
+  VkeFrameAllocation pushUniform(const T &value) {
+    VkeFrameAllocation allocation = allocateUniform(sizeof(T));
+    memcpy(allocation.data, &value, sizeof(T));
+    return allocation;
+  }
+
+  VkBuffer getBuffer() { return buffer; }
+  VkDeviceSize bytesUsed() { return head - frameBase; }
+
+ private:
+  static constexpr VkDeviceSize VERTEX_ALIGNMENT = 16;
+
+  VkDerkDevice &device;
+  VkBuffer buffer;
+  VkeAllocation bufferAllocation;
+
+  VkDeviceSize bytesPerFrame;
+  uint32_t frameCount;
+  VkDeviceSize uniformAlignment;
+  VkDeviceSize storageAlignment;
+
+  VkDeviceSize frameBase = 0;
+  VkDeviceSize head = 0;
+};
+
+}  // namespace vke
@@ -0,0 +1,376 @@
+#include "vke_mesh_pool.hpp"
+
+// std headers
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+#include <stdexcept>
+#include <vector>
+
+namespace vke {
+
+void VkeMeshPool::RangeList::reset(uint32_t newCapacity, uint32_t newUsed) {
+  capacity = newCapacity;
+  used = newUsed;
+  freeRanges.clear();
+  if (newUsed < newCapacity) {
+    freeRanges[newUsed] = newCapacity - newUsed;
+  }
+}
+
+bool VkeMeshPool::RangeList::allocate(uint32_t count, uint32_t &first) {
+  if (count == 0) {
+    first = 0;
+    return true;
+  }
+  for (auto it = freeRanges.begin(); it != freeRanges.end(); ++it) {
+    if (it->second < count) {
+      continue;
+    }
+    first = it->first;
+    uint32_t remaining = it->second - count;
+    freeRanges.erase(it);
+    if (remaining > 0) {
+      freeRanges[first + count] = remaining;
+    }
+    used += count;
+    return true;
+  }
+  return false;
+}
+
+void VkeMeshPool::RangeList::free(uint32_t first, uint32_t count) {
+  if (count == 0) {
+    return;
+  }
+  used -= count;
+
+  auto next = freeRanges.lower_bound(first);
+  if (next != freeRanges.end() && first + count == next->first) {
+    count += next->second;
+    next = freeRanges.erase(next);
+  }
+  if (next != freeRanges.begin()) {
+    auto prev = std::prev(next);
+    if (prev->first + prev->second == first) {
+      prev->second += count;
+      return;
+    }
+  }
+  freeRanges[first] = count;
+}
+
+uint32_t VkeMeshPool::RangeList::holes() const {
+  uint32_t free = capacity - used;
+  if (!freeRanges.empty()) {
+    auto last = std::prev(freeRanges.end());
+    if (last->first + last->second == capacity) {
+      free -= last->second;
+    }
+  }
+  return free;
+}
+
+VkeMeshPool::VkeMeshPool(
+    VkDerkDevice &device, uint32_t vertexStride, uint32_t vertexCapacity, uint32_t indexCapacity)
+    : device_{device}, stride{vertexStride} {
+  assert(vertexStride > 0 && vertexCapacity > 0 && "mesh pool needs room for vertices");
+  createBuffers(vertexCapacity, indexCapacity);
+  vertexRanges.reset(vertexCapacity, 0);
+  indexRanges.reset(indexCapacity, 0);
+}
+
+VkeMeshPool::~VkeMeshPool() {
+  device_.uploader().wait(lastTicket);  // no copy may still be reading or writing the buffers
+  if (pendingCompaction) {
+    destroyBuffers(pendingCompaction->source);
+    for (BufferSet &intermediate : pendingCompaction->intermediates) {
+      destroyBuffers(intermediate);
+    }
+  }
+  BufferSet current = currentBuffers();
+  destroyBuffers(current);
+}
+
+VkeMeshPool::BufferSet VkeMeshPool::currentBuffers() const {
+  return {vertexBuffer, vertexAllocation, indexBuffer, indexAllocation};
+}
+
+void VkeMeshPool::destroyBuffers(BufferSet &buffers) {
+  device_.destroyBuffer(buffers.vertexBuffer, buffers.vertexAllocation);
+  if (buffers.indexBuffer != VK_NULL_HANDLE) {
+    device_.destroyBuffer(buffers.indexBuffer, buffers.indexAllocation);
+  }
+}
+
+void VkeMeshPool::createBuffers(uint32_t vertexCapacity, uint32_t indexCapacity) {
+  // TRANSFER_SRC so compaction can copy live meshes out into the next buffers
+  device_.createBuffer(
+      static_cast<VkDeviceSize>(vertexCapacity) * stride,
+      VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+          VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+      vertexBuffer,
+      vertexAllocation);
+
+  indexBuffer = VK_NULL_HANDLE;
+  indexAllocation = VkeAllocation{};
+  if (indexCapacity > 0) {
+    device_.createBuffer(
+        static_cast<VkDeviceSize>(indexCapacity) * sizeof(uint32_t),
+        VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        indexBuffer,
+        indexAllocation);
+  }
+}
+
+VkeMeshPool::Handle VkeMeshPool::allocate(
+    const void *vertexData, uint32_t vertexCount, const uint32_t *indexData, uint32_t indexCount) {
+  assert(vertexCount > 0 && "mesh needs vertices");
+  releaseRetired();
+
+  Mesh mesh{};
+  if (!reserve(vertexCount, indexCount, mesh.range)) {
+    // repacking may be enough, otherwise grow to at least twice the size
+    uint32_t vertexCapacity = vertexRanges.capacity;
+    uint32_t indexCapacity = indexRanges.capacity;
+    uint32_t liveVertices = 0;
+    uint32_t liveIndices = 0;
+    for (auto &kv : meshes) {
+      liveVertices += kv.second.range.vertexCount;
+      liveIndices += kv.second.range.indexCount;
+    }
+    if (liveVertices + vertexCount > vertexCapacity) {
+      vertexCapacity = std::max(vertexCapacity * 2, liveVertices + vertexCount);
+    }
+    if (liveIndices + indexCount > indexCapacity) {
+      indexCapacity = std::max(indexCapacity * 2, liveIndices + indexCount);
+    }
+    compact(vertexCapacity, indexCapacity);
+
+    if (!reserve(vertexCount, indexCount, mesh.range)) {
+      throw std::runtime_error("failed to allocate mesh pool range!");
+    }
+  }
+
+  mesh.ticket = device_.uploader().uploadBuffer(
+      vertexData,
+      static_cast<VkDeviceSize>(vertexCount) * stride,
+      vertexBuffer,
+      static_cast<VkDeviceSize>(mesh.range.firstVertex) * stride);
+  if (indexCount > 0) {
+    mesh.ticket = device_.uploader().uploadBuffer(
+        indexData,
+        static_cast<VkDeviceSize>(indexCount) * sizeof(uint32_t),
+        indexBuffer,
+        static_cast<VkDeviceSize>(mesh.range.firstIndex) * sizeof(uint32_t));
+  }
+  lastTicket = std::max(lastTicket, mesh.ticket);
+
+  // the old buffers frames draw from during a compaction don't have this mesh
+  mesh.drawRange = mesh.range;
+  mesh.drawTicket = mesh.ticket;
+  mesh.drawable = !pendingCompaction;
+
+  Handle handle = nextHandle++;
+  meshes.emplace(handle, mesh);
+  return handle;
+}
+
+bool VkeMeshPool::reserve(uint32_t vertexCount, uint32_t indexCount, VkeMeshRange &range) {
+  if (!vertexRanges.allocate(vertexCount, range.firstVertex)) {
+    return false;
+  }
+  if (!indexRanges.allocate(indexCount, range.firstIndex)) {
+    vertexRanges.free(range.firstVertex, vertexCount);
+    return false;
+  }
+  range.vertexCount = vertexCount;
+  range.indexCount = indexCount;
+  return true;
+}
+
+void VkeMeshPool::free(Handle handle) {
+  auto it = meshes.find(handle);
+  if (it == meshes.end()) {
+    return;
+  }
+
+  // frames already submitted may still draw from the range, and the upload or compaction copy
+  // that filled it may still be writing: uploads carry no write-after-write barrier, so a new mesh
+  // in the same range could otherwise be overwritten by the stale copy
+  pendingFrees.push_back(
+      {device_.deletionQueue().lastSubmittedSerial(), it->second.ticket, it->second.range});
+  meshes.erase(it);
+
+  // one repack at a time, the holes are still there once it has landed
+  releaseRetired();
+  if (fragmented() && !pendingCompaction) {
+    compact();
+  }
+}
+
+void VkeMeshPool::releaseRetired() {
+  uint64_t completed = device_.deletionQueue().completedSerial();
+  for (auto it = pendingFrees.begin(); it != pendingFrees.end();) {
+    if (it->serial > completed) {
+      break;  // serials are in submission order, nothing later has retired either
+    }
+    if (!device_.uploader().isComplete(it->ticket)) {
+      ++it;  // tickets aren't ordered with serials, a later free may already be done
+      continue;
+    }
+    vertexRanges.free(it->range.firstVertex, it->range.vertexCount);
+    indexRanges.free(it->range.firstIndex, it->range.indexCount);
+    it = pendingFrees.erase(it);
+  }
+}
+
+bool VkeMeshPool::fragmented() const {
+  return vertexRanges.holes() > vertexRanges.capacity / COMPACTION_DIVISOR ||
+         indexRanges.holes() > indexRanges.capacity / COMPACTION_DIVISOR;
+}
+
+void VkeMeshPool::compact(uint32_t newVertexCapacity, uint32_t newIndexCapacity) {
+  BufferSet old = currentBuffers();
+  VkBuffer oldVertexBuffer = old.vertexBuffer;
+  VkBuffer oldIndexBuffer = old.indexBuffer;
+
+  createBuffers(newVertexCapacity, newIndexCapacity);
+
+  // pack live meshes in their current order so neighbours stay neighbours
+  std::vector<Mesh *> live;
+  live.reserve(meshes.size());
+  for (auto &kv : meshes) {
+    live.push_back(&kv.second);
+  }
+  std::sort(live.begin(), live.end(), [](const Mesh *a, const Mesh *b) {
+    return a->range.firstVertex < b->range.firstVertex;
+  });
+
+  // one multi-region copy per buffer, ordered after any upload into the old buffers still sitting
+  // in the uploader
+  std::vector<VkBufferCopy> vertexCopies;
+  std::vector<VkBufferCopy> indexCopies;
+  vertexCopies.reserve(live.size());
+  uint32_t vertexHead = 0;
+  uint32_t indexHead = 0;
+  for (Mesh *mesh : live) {
+    VkeMeshRange &range = mesh->range;
+    VkBufferCopy vertexCopy{};
+    vertexCopy.srcOffset = static_cast<VkDeviceSize>(range.firstVertex) * stride;
+    vertexCopy.dstOffset = static_cast<VkDeviceSize>(vertexHead) * stride;
+    vertexCopy.size = static_cast<VkDeviceSize>(range.vertexCount) * stride;
+    vertexCopies.push_back(vertexCopy);
+    range.firstVertex = vertexHead;
+    vertexHead += range.vertexCount;
+
+    if (range.indexCount > 0) {
+      VkBufferCopy indexCopy{};
+      indexCopy.srcOffset = static_cast<VkDeviceSize>(range.firstIndex) * sizeof(uint32_t);
+      indexCopy.dstOffset = static_cast<VkDeviceSize>(indexHead) * sizeof(uint32_t);
+      indexCopy.size = static_cast<VkDeviceSize>(range.indexCount) * sizeof(uint32_t);
+      indexCopies.push_back(indexCopy);
+      range.firstIndex = indexHead;
+      indexHead += range.indexCount;
+    }
+  }
+
+  // both land in the same open batch, so the later ticket covers the two
+  VkeUploader &uploader = device_.uploader();
+  VkeUploadTicket ticket = uploader.copyBuffer(oldVertexBuffer, vertexBuffer, vertexCopies);
+  ticket = std::max(ticket, uploader.copyBuffer(oldIndexBuffer, indexBuffer, indexCopies));
+  uploader.flush();
+  lastTicket = std::max(lastTicket, ticket);
+
+  // No wait: frames keep drawing the old buffers (each mesh's drawRange) until bind() sees the copy
+  // completed. Meshes in the new buffers become ready with it
+  for (Mesh *mesh : live) {
+    mesh->ticket = ticket;
+  }
+  if (pendingCompaction) {
+    pendingCompaction->intermediates.push_back(old);  // frames still draw from the older source
+  } else {
+    pendingCompaction = std::make_unique<PendingCompaction>();
+    pendingCompaction->source = old;
+  }
+  pendingCompaction->ticket = ticket;
+
+  // ranges waiting on in-flight frames live on in the old buffers, nothing to carry over
+  pendingFrees.clear();
+  vertexRanges.reset(newVertexCapacity, vertexHead);
+  indexRanges.reset(newIndexCapacity, indexHead);
+}
+
+// Called from bind() only, so every draw recorded after it reads the new buffers
+void VkeMeshPool::finishCompaction() {
+  if (!pendingCompaction || !device_.uploader().isComplete(pendingCompaction->ticket)) {
+    return;
+  }
+  for (auto &kv : meshes) {
+    Mesh &mesh = kv.second;
+    mesh.drawRange = mesh.range;
+    mesh.drawTicket = mesh.ticket;
+    mesh.drawable = true;
+  }
+
+  // frames submitted so far may still read the old source, the copies are done with all of them
+  std::vector<BufferSet> retired = std::move(pendingCompaction->intermediates);
+  retired.push_back(pendingCompaction->source);
+  pendingCompaction.reset();
+
+  VkDerkDevice &dev = device_;
+  device_.deletionQueue().push([&dev, retired]() mutable {
+    for (BufferSet &buffers : retired) {
+      dev.destroyBuffer(buffers.vertexBuffer, buffers.vertexAllocation);
+      if (buffers.indexBuffer != VK_NULL_HANDLE) {
+        dev.destroyBuffer(buffers.indexBuffer, buffers.indexAllocation);
+      }
+    }
+  });
+}
+
+bool VkeMeshPool::isReady(Handle handle) {
+  auto it = meshes.find(handle);
+  assert(it != meshes.end() && "unknown mesh handle");
+  Mesh &mesh = it->second;
+  if (!mesh.drawable) {
+    return false;
+  }
+  if (mesh.drawTicket != 0 && device_.uploader().isComplete(mesh.drawTicket)) {
+    mesh.drawTicket = 0;
+  }
+  return mesh.drawTicket == 0;
+}
+
+const VkeMeshRange &VkeMeshPool::range(Handle handle) const {
+  auto it = meshes.find(handle);
+  assert(it != meshes.end() && "unknown mesh handle");
+  return it->second.drawRange;
+}
+
+void VkeMeshPool::bind(VkCommandBuffer commandBuffer) {
+  finishCompaction();
+  const BufferSet drawBuffers = pendingCompaction ? pendingCompaction->source : currentBuffers();
+
+  VkBuffer buffers[] = {drawBuffers.vertexBuffer};
+  VkDeviceSize offsets[] = {0};
+  vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+  if (drawBuffers.indexBuffer != VK_NULL_HANDLE) {
+    vkCmdBindIndexBuffer(commandBuffer, drawBuffers.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+  }
+}
+
+void VkeMeshPool::draw(VkCommandBuffer commandBuffer, Handle handle, uint32_t instanceCount) {
+  const VkeMeshRange &mesh = range(handle);
+  if (mesh.indexCount > 0) {
+    vkCmdDrawIndexed(
+        commandBuffer, mesh.indexCount, instanceCount, mesh.firstIndex, mesh.vertexOffset(), 0);
+  } else {
+    vkCmdDraw(commandBuffer, mesh.vertexCount, instanceCount, mesh.firstVertex, 0);
+  }
+}
+
+}  // namespace vke
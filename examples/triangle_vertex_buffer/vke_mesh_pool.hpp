@@ -0,0 +1,150 @@
+#pragma once
+
+#include "vk_derk_device.hpp"
+
+// vulkan headers
+#include <vulkan/vulkan.h>
+
+// std lib headers
+#include <deque>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace vke {
+
+// Where a mesh lives inside the pool, in vertices / indices (not bytes). Indexed draws pass
+// vertexOffset() so indices stay relative to the mesh's own first vertex.
+struct VkeMeshRange {
+  uint32_t firstVertex = 0;
+  uint32_t vertexCount = 0;
+  uint32_t firstIndex = 0;
+  uint32_t indexCount = 0;
+
+  int32_t vertexOffset() const { return static_cast<int32_t>(firstVertex); }
+};
+
+// Shared geometry arena: every mesh sub-allocates a vertex range (and optionally a 32-bit index range)
+// out of one device local vertex buffer and one index buffer, so a frame's geometry needs a single
+// bind() followed by one draw() per mesh.
+//
+// Freed ranges are only reused once the frames that were in flight at free time have completed and
+// the upload (or compaction copy) into them has landed.
+// When holes take up more than a quarter of a buffer, or an allocation doesn't fit, live meshes are
+// copied packed into fresh buffers (grown if needed) on the transfer queue. Nothing waits for that
+// copy: frames keep drawing the old buffers at the old ranges until the copy has landed, then the
+// next bind() switches over and the old buffers go through the device deletion queue. Mesh ranges
+// change on compaction, so always look them up through the handle. Not thread safe: allocate, free
+// and record from the render thread.
+class VkeMeshPool {
+ public:
+  using Handle = uint64_t;
+
+  VkeMeshPool(
+      VkDerkDevice &device, uint32_t vertexStride, uint32_t vertexCapacity, uint32_t indexCapacity);
+  ~VkeMeshPool();
+
+  VkeMeshPool(const VkeMeshPool &) = delete;
+  VkeMeshPool &operator=(const VkeMeshPool &) = delete;
+
+  // vertexData holds vertexCount * vertexStride bytes; indices are relative to the mesh's first vertex
+  Handle allocate(
+      const void *vertexData,
+      uint32_t vertexCount,
+      const uint32_t *indexData = nullptr,
+      uint32_t indexCount = 0);
+  void free(Handle handle);
+
+  // uploads are asynchronous, don't draw a mesh before this returns true
+  bool isReady(Handle handle);
+  // where draw() reads the mesh from, in the buffers bind() binds
+  const VkeMeshRange &range(Handle handle) const;
+
+  // once per frame before the draws: switches to compacted buffers whose copy has completed
+  void bind(VkCommandBuffer commandBuffer);
+  void draw(VkCommandBuffer commandBuffer, Handle handle, uint32_t instanceCount = 1);
+
+  // repack live meshes now, keeping the current capacities
+  void compact() { compact(vertexRanges.capacity, indexRanges.capacity); }
+
+  VkDerkDevice &device() { return device_; }
+  uint32_t vertexStride() const { return stride; }
+  // includes freed ranges still waiting on in-flight frames
+  uint32_t usedVertexCount() const { return vertexRanges.used; }
+  uint32_t usedIndexCount() const { return indexRanges.used; }
+
+ private:
+  static constexpr uint32_t COMPACTION_DIVISOR = 4;  // compact once holes exceed capacity / 4
+
+  // first-fit free list over [0, capacity), offset -> count, merged on free
+  struct RangeList {
+    uint32_t capacity = 0;
+    uint32_t used = 0;
+    std::map<uint32_t, uint32_t> freeRanges;
+
+    void reset(uint32_t newCapacity, uint32_t newUsed);
+    bool allocate(uint32_t count, uint32_t &first);
+    void free(uint32_t first, uint32_t count);
+    uint32_t holes() const;  // free space that isn't the tail
+  };
+
+  struct Mesh {
+    VkeMeshRange range;  // in the current buffers, where allocations and compaction copies go
+    VkeUploadTicket ticket = 0;
+    // what frames draw: the same as range/ticket, except while a compaction is in flight, when it
+    // is the mesh's place in the old buffers (drawable false if it was allocated since)
+    VkeMeshRange drawRange;
+    VkeUploadTicket drawTicket = 0;
+    bool drawable = true;
+  };
+
+  struct BufferSet {
+    VkBuffer vertexBuffer = VK_NULL_HANDLE;
+    VkeAllocation vertexAllocation;
+    VkBuffer indexBuffer = VK_NULL_HANDLE;
+    VkeAllocation indexAllocation;
+  };
+
+  // compaction whose copies haven't landed yet: frames draw from `source`. A compaction started
+  // while one is pending copies out of buffers nobody draws from, those wait in `intermediates`
+  struct PendingCompaction {
+    BufferSet source;
+    std::vector<BufferSet> intermediates;
+    VkeUploadTicket ticket = 0;
+  };
+
+  // a freed range is reusable once the frames drawing it and the last transfer writing it are done
+  struct PendingFree {
+    uint64_t serial;
+    VkeUploadTicket ticket;
+    VkeMeshRange range;
+  };
+
+  void createBuffers(uint32_t vertexCapacity, uint32_t indexCapacity);
+  void compact(uint32_t newVertexCapacity, uint32_t newIndexCapacity);
+  bool reserve(uint32_t vertexCount, uint32_t indexCount, VkeMeshRange &range);
+  void releaseRetired();
+  bool fragmented() const;
+  void finishCompaction();
+  void destroyBuffers(BufferSet &buffers);
+  BufferSet currentBuffers() const;
+
+  VkDerkDevice &device_;
+  uint32_t stride;
+
+  VkBuffer vertexBuffer = VK_NULL_HANDLE;
+  VkeAllocation vertexAllocation;
+  VkBuffer indexBuffer = VK_NULL_HANDLE;
+  VkeAllocation indexAllocation;
+
+  RangeList vertexRanges;
+  RangeList indexRanges;
+  std::unordered_map<Handle, Mesh> meshes;
+  std::deque<PendingFree> pendingFrees;
+  std::unique_ptr<PendingCompaction> pendingCompaction;
+  Handle nextHandle = 1;
+  VkeUploadTicket lastTicket = 0;
+};
+
+}  // namespace vke
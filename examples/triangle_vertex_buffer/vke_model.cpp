@@ -1,66 +1,258 @@
 #include "vke_model.hpp"
 
 #include <cassert>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <unordered_map>
 namespace vke {
 
-	VkeModel::VkeModel(VkDerkDevice& device, const std::vector<Vertex>& vertices) : vkDerkDevice{ device } {
-		createVertexBuffers(vertices);
+	VkeModel::VkeModel(VkDerkDevice& device, const std::vector<Vertex>& vertices, MemoryPolicy policy, const VkeVertexLayout& layout) : vkDerkDevice{ device }, layout{ layout } {
+		std::vector<Vertex> welded;
+		std::vector<uint32_t> indices;
+		weldVertices(vertices, welded, indices);
+		createBuffers(welded, indices, policy);
+	}
+
+	VkeModel::VkeModel(VkDerkDevice& device, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, MemoryPolicy policy, const VkeVertexLayout& layout) : vkDerkDevice{ device }, layout{ layout } {
+		createBuffers(vertices, indices, policy);
+	}
+
+	VkeModel::VkeModel(VkeMeshPool& pool, const std::vector<Vertex>& vertices, const VkeVertexLayout& layout) : vkDerkDevice{ pool.device() }, layout{ layout }, meshPool{ &pool } {
+		std::vector<Vertex> welded;
+		std::vector<uint32_t> indices;
+		weldVertices(vertices, welded, indices);
+		createInPool(welded, indices);
+	}
+
+	VkeModel::VkeModel(VkeMeshPool& pool, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, const VkeVertexLayout& layout) : vkDerkDevice{ pool.device() }, layout{ layout }, meshPool{ &pool } {
+		createInPool(vertices, indices);
 	}
 
 	VkeModel::~VkeModel() {
-		vkDestroyBuffer(vkDerkDevice.device(), vertexBuffer, nullptr);
-		vkFreeMemory(vkDerkDevice.device(), vertexBufferMemory, nullptr);	// implement VMA???
+		if (meshPool != nullptr) {
+			meshPool->free(meshHandle);		// range is recycled once in-flight frames are done with it
+			return;
+		}
+		if (vertexDefragHandle != 0) {
+			vkDerkDevice.defragmenter().unregisterBuffer(vertexDefragHandle);		// also waits out a move that is still copying
+			vkDerkDevice.defragmenter().unregisterBuffer(indexDefragHandle);
+		}
+
+		// Frames still in flight may draw from the buffers: they go once those have retired (deletion queue).
+		// By then the upload has landed too, the transfer timeline wait is only there for a model that was never drawn.
+		// (upload tickets are transfer timeline values; the uploader itself may already be gone when the queue is flushed)
+		VkDerkDevice& device = vkDerkDevice;
+		VkeUploadTicket ticket = uploadTicket;
+		VkBuffer vertices = vertexBuffer;
+		VkeAllocation vertexAllocation = vertexBufferAllocation;
+		VkBuffer indices = indexBuffer;
+		VkeAllocation indexAllocation = indexBufferAllocation;
+		vkDerkDevice.deletionQueue().push([&device, ticket, vertices, vertexAllocation, indices, indexAllocation]() mutable {
+			device.transferTimeline().wait(ticket);
+			device.destroyBuffer(vertices, vertexAllocation);		// returns the ranges to the device allocator
+			device.destroyBuffer(indices, indexAllocation);
+		});
 	}
 
-	void VkeModel::createVertexBuffers(const std::vector<Vertex>& vertices) {
+	// Hash map from vertex to its first index. Unique vertices keep first-seen order, so a soup that is already
+	// vertex cache friendly stays that way.
+	void VkeModel::weldVertices(const std::vector<Vertex>& soup, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+		// FNV-1a over the attribute bits, consistent with the bitwise operator==
+		struct VertexHash {
+			size_t operator()(const Vertex& vertex) const {
+				uint32_t bits[8];
+				memcpy(&bits[0], &vertex.position, sizeof(float) * 2);
+				memcpy(&bits[2], &vertex.normal, sizeof(float) * 3);
+				memcpy(&bits[5], &vertex.color, sizeof(float) * 3);
+				uint64_t hash = 14695981039346656037ull;
+				for (uint32_t word : bits) {
+					hash = (hash ^ word) * 1099511628211ull;
+				}
+				return static_cast<size_t>(hash);
+			}
+		};
+
+		std::unordered_map<Vertex, uint32_t, VertexHash> uniqueVertices;
+		uniqueVertices.reserve(soup.size());
+		vertices.clear();
+		vertices.reserve(soup.size());
+		indices.clear();
+		indices.reserve(soup.size());
+
+		for (const Vertex& vertex : soup) {
+			auto inserted = uniqueVertices.emplace(vertex, static_cast<uint32_t>(vertices.size()));
+			if (inserted.second) {
+				vertices.push_back(vertex);
+			}
+			indices.push_back(inserted.first->second);
+		}
+	}
+
+	void VkeModel::createBuffers(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, MemoryPolicy policy) {
 
 		vertexCount = static_cast<uint32_t>(vertices.size());
-		assert(vertexCount >= 3 && "Vertex count must be at least 3!");		// make sure we have at least 3 vertices to form 1 triangle
+		indexCount = static_cast<uint32_t>(indices.size());
+		assert(indexCount >= 3 && "Index count must be at least 3!");		// make sure we have at least 1 triangle
+
+		std::vector<uint8_t> vertexData = encodeVertices(vertices, layout);	// quantized to the model's layout
+		VkDeviceSize vertexBufferSize = vertexData.size();					// stride * n vertices = buffer size
+
+		// Half the index bytes whenever the vertex count allows it
+		std::vector<uint16_t> shortIndices;
+		const void* indexData = indices.data();
+		VkDeviceSize indexBufferSize = sizeof(uint32_t) * indexCount;
+		indexType = VK_INDEX_TYPE_UINT32;
+		if (vertexCount <= std::numeric_limits<uint16_t>::max()) {
+			shortIndices.assign(indices.begin(), indices.end());
+			indexData = shortIndices.data();
+			indexBufferSize = sizeof(uint16_t) * indexCount;
+			indexType = VK_INDEX_TYPE_UINT16;
+		}
 
-		VkDeviceSize bufferSize = sizeof(vertices[0]) * vertexCount;		// size of vertex * n vertices = buffer size
+		deviceLocal = policy == MemoryPolicy::DeviceLocal ||
+			(policy == MemoryPolicy::Auto && vertexBufferSize + indexBufferSize >= STAGING_THRESHOLD);
+
+		createBuffer(vertexData.data(), vertexBufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vertexBuffer, vertexBufferAllocation, vertexDefragHandle);
+		createBuffer(indexData, indexBufferSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, indexBuffer, indexBufferAllocation, indexDefragHandle);
+	}
 
-		// Use createBuffer from device class
+	void VkeModel::createBuffer(const void* data, VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer, VkeAllocation& allocation, VkeDefragmenter::Handle& defragHandle) {
+
+		if (!deviceLocal) {
+			// Use createBuffer from device class
+			vkDerkDevice.createBuffer(
+				size,
+				usage,																			// vertex or index buffer
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,		// makes memory accessible and consitent btwn host+device
+				buffer,
+				allocation);
+
+			// Host visible blocks stay mapped by the allocator, so no vkMapMemory here: the allocation already points at our range
+			memcpy(allocation.mapped, data, static_cast<size_t>(size));	// coherent bit auto flushes mem to device
+			return;
+		}
+
+		// Staging path: the uploader copies the data into a staging buffer and records a copy into device local memory
+		// on the transfer queue. Creation returns right away, isReady() tells when the copy has landed.
+		// TRANSFER_SRC so the defragmenter can copy the buffer out when it compacts the block it lives in
+		usage |= VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
 		vkDerkDevice.createBuffer(
-			bufferSize,
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,												// says this is a vertex buffer
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,		// makes memory accessible and consitent btwn host+device
-			vertexBuffer,
-			vertexBufferMemory);
-	
-		void* data;	
-		vkMapMemory(vkDerkDevice.device(), vertexBufferMemory, 0, bufferSize, 0, &data);	// data set to point to beginning of mapped memory
-		memcpy(data, vertices.data(), static_cast<size_t>(bufferSize));
-		vkUnmapMemory(vkDerkDevice.device(), vertexBufferMemory);							// memcpy copies vertice data into host mapped mem--> coherent bit auto flushes mem to device
+			size,
+			usage,																			// filled by a copy
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,											// fastest memory for the GPU, not CPU accessible
+			buffer,
+			allocation);
+
+		uploadTicket = vkDerkDevice.uploader().uploadBuffer(data, size, buffer);	// later tickets complete later, keep the last
+
+		// buffer/allocation may get swapped for a copy elsewhere between frames, bind() always reads the current one
+		defragHandle = vkDerkDevice.defragmenter().registerBuffer(&buffer, &allocation, size, usage);
+	}
+
+	void VkeModel::createInPool(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices) {
+		vertexCount = static_cast<uint32_t>(vertices.size());
+		indexCount = static_cast<uint32_t>(indices.size());
+		assert(indexCount >= 3 && "Index count must be at least 3!");
+		assert(meshPool->vertexStride() == layout.stride() && "mesh pool stride doesn't match the model's vertex layout");
+
+		deviceLocal = true;
+		indexType = VK_INDEX_TYPE_UINT32;	// the pool's index buffer is shared, so one width for everyone
+		std::vector<uint8_t> vertexData = encodeVertices(vertices, layout);
+		meshHandle = meshPool->allocate(vertexData.data(), vertexCount, indices.data(), indexCount);	// async upload into the pool's buffers
+	}
+
+	bool VkeModel::isReady() {
+		if (meshPool != nullptr) {
+			return meshPool->isReady(meshHandle);
+		}
+		return uploadTicket == 0 || vkDerkDevice.uploader().isComplete(uploadTicket);
+	}
+
+	void VkeModel::updateVertices(const std::vector<Vertex>& vertices) {
+		assert(!deviceLocal && meshPool == nullptr && "updateVertices requires a host visible model");
+		assert(vertices.size() == vertexCount && "updateVertices cannot resize the vertex buffer");
+		std::vector<uint8_t> vertexData = encodeVertices(vertices, layout);
+		memcpy(vertexBufferAllocation.mapped, vertexData.data(), vertexData.size());
 	}
 
 	void VkeModel::bind(VkCommandBuffer commandBuffer) {
+		if (meshPool != nullptr) {
+			meshPool->bind(commandBuffer);
+			return;
+		}
 		VkBuffer buffers[] = { vertexBuffer };
 		VkDeviceSize offsets[] = { 0 };
 		vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);	// records to command buffer to bind one vertex buffer at 0 w offset 0
+		vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, indexType);
 	}
 
 	void VkeModel::draw(VkCommandBuffer commandBuffer) {
-		vkCmdDraw(commandBuffer, vertexCount, 1, 0, 0);
+		if (meshPool != nullptr) {
+			meshPool->draw(commandBuffer, meshHandle);	// firstIndex/vertexOffset = where our ranges start in the pool
+			return;
+		}
+		vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, 0);
 	}
 
-	// Vertex struct's fxn in model header
-	std::vector<VkVertexInputBindingDescription> VkeModel::Vertex::getBindingDescriptions() {
-		std::vector< VkVertexInputBindingDescription> bindingDescriptions(1);
-		bindingDescriptions[0].binding = 0;
-		bindingDescriptions[0].stride = sizeof(Vertex);
-		bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+	VkeVertexLayout VkeModel::chooseLayout(const std::vector<Vertex>& vertices, const VkeQuantizationBounds& bounds, bool withNormals, bool withColors) {
+		// Start from the smallest format of each attribute and fall back one size whenever a vertex exceeds the bound
+		VkeVertexLayout layout{};
+		layout.position = bounds.position > 0.0f ? VkePositionFormat::Float16 : VkePositionFormat::Float32;
+		// Octahedral normals need a decoding shader, so they're only a candidate when the caller says so
+		layout.normal = !withNormals ? VkeNormalFormat::None
+			: bounds.allowOctahedral ? VkeNormalFormat::Octahedral16 : VkeNormalFormat::Snorm16;
+		layout.color = withColors ? VkeColorFormat::Unorm8 : VkeColorFormat::None;
 
-		return bindingDescriptions;
+		for (const Vertex& vertex : vertices) {
+			if (layout.position == VkePositionFormat::Float16 &&
+				VkeVertexLayout::positionError(layout.position, vertex.position) > bounds.position) {
+				layout.position = VkePositionFormat::Float32;
+			}
+			while (layout.normal != VkeNormalFormat::None && layout.normal != VkeNormalFormat::Float32 &&
+				VkeVertexLayout::normalErrorDegrees(layout.normal, vertex.normal) > bounds.normalDegrees) {
+				// next larger format: Octahedral16 -> Snorm16 -> Float32
+				switch (layout.normal) {
+				case VkeNormalFormat::Octahedral16:
+					layout.normal = VkeNormalFormat::Snorm16;
+					break;
+				case VkeNormalFormat::Snorm16:
+					layout.normal = VkeNormalFormat::Float32;
+					break;
+				default:
+					break;
+				}
+			}
+			if (layout.color == VkeColorFormat::Unorm8 &&
+				VkeVertexLayout::colorError(layout.color, vertex.color) > bounds.color) {
+				layout.color = VkeColorFormat::Float32;
+			}
+		}
+		return layout;
 	}
 
-	std::vector<VkVertexInputAttributeDescription> VkeModel::Vertex::getAttributeDescriptions() {
-		std::vector< VkVertexInputAttributeDescription> attributeDescriptions(1);
-		attributeDescriptions[0].binding = 0;
-		attributeDescriptions[0].location = 0;
-		attributeDescriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
-		attributeDescriptions[0].offset = 0;
+	std::vector<uint8_t> VkeModel::encodeVertices(const std::vector<Vertex>& vertices, const VkeVertexLayout& layout) {
+		uint32_t stride = layout.stride();
+		std::vector<uint8_t> data(static_cast<size_t>(stride) * vertices.size());
+		for (size_t i = 0; i < vertices.size(); i++) {
+			layout.encode(vertices[i].position, vertices[i].normal, vertices[i].color, data.data() + i * stride);
+		}
+		return data;
+	}
+
+	bool VkeModel::Vertex::operator==(const Vertex& other) const {
+		return memcmp(&position, &other.position, sizeof(position)) == 0 &&
+			memcmp(&normal, &other.normal, sizeof(normal)) == 0 &&
+			memcmp(&color, &other.color, sizeof(color)) == 0;
+	}
 
-		return attributeDescriptions;
+	// Vertex struct's fxn in model header: the default layout is the plain float2 position the shaders started with
+	std::vector<VkVertexInputBindingDescription> VkeModel::Vertex::getBindingDescriptions() {
+		return VkeVertexLayout{}.getBindingDescriptions();
+	}
+
+	std::vector<VkVertexInputAttributeDescription> VkeModel::Vertex::getAttributeDescriptions() {
+		return VkeVertexLayout{}.getAttributeDescriptions();
 	}
 
 }
\ No newline at end of file
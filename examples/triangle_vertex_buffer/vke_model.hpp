@@ -1,6 +1,8 @@
 #pragma once
 
 #include "vk_derk_device.hpp"
+#include "vke_mesh_pool.hpp"
+#include "vke_vertex_layout.hpp"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -15,13 +17,37 @@ namespace vke {
 
 	public:
 
+		// CPU side vertex, always full float. What reaches the GPU is decided by the model's VkeVertexLayout,
+		// normal/color only take up buffer space when the layout asks for them.
 		struct Vertex {
 			glm::vec2 position;
+			glm::vec3 normal{ 0.0f };
+			glm::vec3 color{ 0.0f };
+
+			// Descriptions of the default (position only, full float) layout
 			static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
 			static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
+
+			// Bitwise equality: welding merges exact duplicates only, never "close enough" vertices
+			bool operator==(const Vertex& other) const;
 		};
-		
-		VkeModel(VkDerkDevice &device, const std::vector<Vertex>& vertices);
+
+		// Where vertex data lives. DeviceLocal goes through a staging copy (fast GPU reads on discrete cards),
+		// HostVisible is written directly by the CPU (for tiny or per-frame dynamic meshes).
+		// Auto stages anything at or above STAGING_THRESHOLD bytes.
+		enum class MemoryPolicy { Auto, DeviceLocal, HostVisible };
+		static constexpr VkDeviceSize STAGING_THRESHOLD = 64 * 1024;
+
+		// Triangle soup: every 3 vertices are a triangle. Duplicates are welded into an index buffer first.
+		// The pipeline drawing the model must be configured with the same layout (PipelineConfigInfo descriptions).
+		VkeModel(VkDerkDevice &device, const std::vector<Vertex>& vertices, MemoryPolicy policy = MemoryPolicy::Auto, const VkeVertexLayout& layout = {});
+		// Already indexed geometry, used as is.
+		VkeModel(VkDerkDevice &device, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, MemoryPolicy policy = MemoryPolicy::Auto, const VkeVertexLayout& layout = {});
+		// Pooled model: vertices/indices live in ranges of the shared mesh pool instead of buffers of their own.
+		// Bind the pool once per frame and only call draw() per model, bind() would rebind the whole pool.
+		// The layout's stride must match the pool's.
+		VkeModel(VkeMeshPool &pool, const std::vector<Vertex>& vertices, const VkeVertexLayout& layout = {});
+		VkeModel(VkeMeshPool &pool, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, const VkeVertexLayout& layout = {});
 		~VkeModel();
 
 		// MUST delete copy constructors: because model class manages buffers and memory
@@ -31,15 +57,51 @@ namespace vke {
 		void bind(VkCommandBuffer commandBuffer);
 		void draw(VkCommandBuffer commandBuffer);
 
+		// Only valid for host visible models. Takes the welded vertex array (getVertexCount() entries, same order),
+		// the index buffer is kept. Caller must make sure no in-flight frame is still reading the buffer.
+		void updateVertices(const std::vector<Vertex>& vertices);
+		bool isDeviceLocal() const { return deviceLocal; }
+		bool isPooled() const { return meshPool != nullptr; }
+		uint32_t getVertexCount() const { return vertexCount; }
+		uint32_t getIndexCount() const { return indexCount; }
+		VkIndexType getIndexType() const { return indexType; }
+		const VkeVertexLayout& getLayout() const { return layout; }
+
+		// Device local models upload asynchronously. Don't record draws until this returns true.
+		bool isReady();
+
+		// Hash based welding pass: unique vertices in first-seen order plus one index per input vertex
+		static void weldVertices(const std::vector<Vertex>& soup, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+		// Load time quantization: the smallest format per attribute whose error stays within bounds for every vertex.
+		// Normals/colors are only included when asked for; normals start at Snorm16 unless bounds.allowOctahedral.
+		static VkeVertexLayout chooseLayout(const std::vector<Vertex>& vertices, const VkeQuantizationBounds& bounds, bool withNormals, bool withColors);
+		// Packs vertices into the interleaved GPU stream of a layout
+		static std::vector<uint8_t> encodeVertices(const std::vector<Vertex>& vertices, const VkeVertexLayout& layout);
+
 	private:
 
-		void createVertexBuffers(const std::vector<Vertex>& vertices);
+		void createBuffers(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, MemoryPolicy policy);
+		void createBuffer(const void* data, VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer, VkeAllocation& allocation, VkeDefragmenter::Handle& defragHandle);
+		void createInPool(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
 
 		VkDerkDevice& vkDerkDevice;
 		VkBuffer vertexBuffer;
-		VkDeviceMemory vertexBufferMemory;		// programmer in control of mem mgmt
+		VkeAllocation vertexBufferAllocation;	// sub-range of a device memory block, owned by the allocator
 		uint32_t vertexCount;
+		VkBuffer indexBuffer;
+		VkeAllocation indexBufferAllocation;
+		uint32_t indexCount;
+		VkIndexType indexType = VK_INDEX_TYPE_UINT32;	// 16 bit whenever every vertex is reachable with one
+		VkeVertexLayout layout;
+		bool deviceLocal = false;
+		VkeUploadTicket uploadTicket = 0;	// 0 = nothing pending (host visible models)
+		VkeDefragmenter::Handle vertexDefragHandle = 0;	// 0 = not movable (host visible models)
+		VkeDefragmenter::Handle indexDefragHandle = 0;
+
+		VkeMeshPool* meshPool = nullptr;			// set for pooled models, which own no buffer
+		VkeMeshPool::Handle meshHandle = 0;
 	};
 
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,257 @@
+#include "vke_offscreen_ring.hpp"
+
+// std headers
+#include <array>
+#include <stdexcept>
+
+namespace vke {
+
+VkeOffscreenRing::VkeOffscreenRing(VkDerkDevice &device, VkExtent2D extent, size_t framesInFlight)
+    : device{device}, extent{extent} {
+  if (framesInFlight == 0 || framesInFlight > MAX_FRAMES_IN_FLIGHT) {
+    throw std::runtime_error("offscreen ring needs 1 to MAX_FRAMES_IN_FLIGHT frames in flight!");
+  }
+  colorImages.resize(framesInFlight);
+  frameValues.assign(framesInFlight, 0);
+
+  createColorResources();
+  createRenderPass();
+  createDepthResources();
+  createFramebuffers();
+}
+
+VkeOffscreenRing::~VkeOffscreenRing() {
+  for (auto framebuffer : framebuffers) {
+    vkDestroyFramebuffer(device.device(), framebuffer, nullptr);
+  }
+  for (auto depthImageView : depthImageViews) {
+    vkDestroyImageView(device.device(), depthImageView, nullptr);
+  }
+  device.destroyAliasedImages(depthImages, depthImageMemory);
+  for (size_t i = 0; i < colorImages.size(); i++) {
+    vkDestroyImageView(device.device(), colorImageViews[i], nullptr);
+    device.destroyImage(colorImages[i], colorImageMemory[i]);
+  }
+  vkDestroyRenderPass(device.device(), renderPass, nullptr);
+}
+
+VkResult VkeOffscreenRing::acquireNextImage(uint32_t *imageIndex) {
+  device.graphicsTimeline().wait(frameValues[currentFrame]);
+  // this slot's previous frame is done, so is everything submitted before it
+  device.deletionQueue().collect();
+
+  *imageIndex = static_cast<uint32_t>(currentFrame);
+  return VK_SUCCESS;
+}
+
+VkResult VkeOffscreenRing::submitCommandBuffers(
+    const VkCommandBuffer *buffers,
+    uint32_t *imageIndex,
+    const std::vector<VkeSemaphoreWait> &extraWaits) {
+  frameValues[*imageIndex] =
+      device.graphicsTimeline().submit(device.graphicsQueue(), 1, buffers, extraWaits);
+  currentFrame = (currentFrame + 1) % frameValues.size();
+  return VK_SUCCESS;
+}
+
+void VkeOffscreenRing::createColorResources() {
+  VkImageCreateInfo imageInfo{};
+  imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  imageInfo.imageType = VK_IMAGE_TYPE_2D;
+  imageInfo.extent.width = extent.width;
+  imageInfo.extent.height = extent.height;
+  imageInfo.extent.depth = 1;
+  imageInfo.mipLevels = 1;
+  imageInfo.arrayLayers = 1;
+  imageInfo.format = COLOR_FORMAT;
+  imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+  imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  colorImageMemory.resize(colorImages.size());
+  colorImageViews.resize(colorImages.size());
+  for (size_t i = 0; i < colorImages.size(); i++) {
+    device.createImageWithInfo(
+        imageInfo,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        colorImages[i],
+        colorImageMemory[i]);
+
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = colorImages[i];
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = COLOR_FORMAT;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = 1;
+
+    if (vkCreateImageView(device.device(), &viewInfo, nullptr, &colorImageViews[i]) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create offscreen image view!");
+    }
+  }
+}
+
+// Same shape as the swap chain's depth: cleared, never stored, one allocation for all images
+void VkeOffscreenRing::createDepthResources() {
+  VkFormat depthFormat = findDepthFormat();
+
+  VkImageCreateInfo imageInfo{};
+  imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  imageInfo.imageType = VK_IMAGE_TYPE_2D;
+  imageInfo.extent.width = extent.width;
+  imageInfo.extent.height = extent.height;
+  imageInfo.extent.depth = 1;
+  imageInfo.mipLevels = 1;
+  imageInfo.arrayLayers = 1;
+  imageInfo.format = depthFormat;
+  imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  imageInfo.usage =
+      VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+  imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  device.createAliasedImages(
+      imageInfo,
+      static_cast<uint32_t>(imageCount()),
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+      depthImages,
+      depthImageMemory);
+
+  depthImageViews.resize(imageCount());
+  for (size_t i = 0; i < depthImages.size(); i++) {
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = depthImages[i];
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = depthFormat;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = 1;
+
+    if (vkCreateImageView(device.device(), &viewInfo, nullptr, &depthImageViews[i]) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create offscreen depth view!");
+    }
+  }
+}
+
+void VkeOffscreenRing::createRenderPass() {
+  VkAttachmentDescription depthAttachment{};
+  depthAttachment.format = findDepthFormat();
+  depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+  depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+  VkAttachmentReference depthAttachmentRef{};
+  depthAttachmentRef.attachment = 1;
+  depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+  // the swap chain's PRESENT_SRC becomes TRANSFER_SRC: ready to be copied out
+  VkAttachmentDescription colorAttachment{};
+  colorAttachment.format = COLOR_FORMAT;
+  colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+  colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  colorAttachment.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+  VkAttachmentReference colorAttachmentRef{};
+  colorAttachmentRef.attachment = 0;
+  colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+  VkSubpassDescription subpass{};
+  subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  subpass.colorAttachmentCount = 1;
+  subpass.pColorAttachments = &colorAttachmentRef;
+  subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+  VkSubpassDependency dependency{};
+  dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+  dependency.dstSubpass = 0;
+  dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  dependency.srcAccessMask = 0;
+  dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+  // depth images alias one allocation, see VkeSwapChain::createRenderPass
+  VkSubpassDependency depthDependency{};
+  depthDependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+  depthDependency.dstSubpass = 0;
+  depthDependency.srcStageMask =
+      VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+  depthDependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  depthDependency.dstStageMask =
+      VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+  depthDependency.dstAccessMask =
+      VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+  // color writes made available to a copy recorded after the pass (readback)
+  VkSubpassDependency readbackDependency{};
+  readbackDependency.srcSubpass = 0;
+  readbackDependency.dstSubpass = VK_SUBPASS_EXTERNAL;
+  readbackDependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  readbackDependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  readbackDependency.dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+  readbackDependency.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+  std::array<VkSubpassDependency, 3> dependencies = {
+      dependency,
+      depthDependency,
+      readbackDependency};
+  std::array<VkAttachmentDescription, 2> attachments = {colorAttachment, depthAttachment};
+  VkRenderPassCreateInfo renderPassInfo{};
+  renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+  renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+  renderPassInfo.pAttachments = attachments.data();
+  renderPassInfo.subpassCount = 1;
+  renderPassInfo.pSubpasses = &subpass;
+  renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+  renderPassInfo.pDependencies = dependencies.data();
+
+  if (vkCreateRenderPass(device.device(), &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create offscreen render pass!");
+  }
+}
+
+void VkeOffscreenRing::createFramebuffers() {
+  framebuffers.resize(imageCount());
+  for (size_t i = 0; i < imageCount(); i++) {
+    std::array<VkImageView, 2> attachments = {colorImageViews[i], depthImageViews[i]};
+
+    VkFramebufferCreateInfo framebufferInfo{};
+    framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    framebufferInfo.renderPass = renderPass;
+    framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+    framebufferInfo.pAttachments = attachments.data();
+    framebufferInfo.width = extent.width;
+    framebufferInfo.height = extent.height;
+    framebufferInfo.layers = 1;
+
+    if (vkCreateFramebuffer(device.device(), &framebufferInfo, nullptr, &framebuffers[i]) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("failed to create offscreen framebuffer!");
+    }
+  }
+}
+
+VkFormat VkeOffscreenRing::findDepthFormat() {
+  return device.findSupportedFormat(
+      {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT},
+      VK_IMAGE_TILING_OPTIMAL,
+      VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+}
+
+}  // namespace vke
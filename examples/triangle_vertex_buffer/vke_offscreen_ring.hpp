@@ -0,0 +1,71 @@
+#pragma once
+
+#include "vk_derk_device.hpp"
+#include "vke_render_target.hpp"
+
+// vulkan headers
+#include <vulkan/vulkan.h>
+
+// std lib headers
+#include <vector>
+
+namespace vke {
+
+// Headless render target: a ring of offscreen color + depth images, one per frame in flight, in
+// place of a swap chain. Nothing is presented, so there is no acquire semaphore, no vsync and no
+// resize; image i belongs to frame slot i and acquireNextImage only waits for that slot's previous
+// frame on the graphics timeline. Frames go out as fast as the GPU retires them.
+//
+// Color images are stored and left in TRANSFER_SRC_OPTIMAL for readback (getImage), depth is
+// transient and aliased like the swap chain's.
+class VkeOffscreenRing : public VkeRenderTarget {
+ public:
+  static constexpr VkFormat COLOR_FORMAT = VK_FORMAT_B8G8R8A8_UNORM;  // what windows usually get
+
+  VkeOffscreenRing(
+      VkDerkDevice &device, VkExtent2D extent, size_t framesInFlight = MAX_FRAMES_IN_FLIGHT);
+  ~VkeOffscreenRing() override;
+
+  VkeOffscreenRing(const VkeOffscreenRing &) = delete;
+  VkeOffscreenRing &operator=(const VkeOffscreenRing &) = delete;
+
+  VkRenderPass getRenderPass() override { return renderPass; }
+  VkFramebuffer getFrameBuffer(int index) override { return framebuffers[index]; }
+  VkExtent2D getExtent() override { return extent; }
+  size_t getCurrentFrame() override { return currentFrame; }
+  size_t imageCount() const { return colorImages.size(); }
+  // color image of a frame, once its timeline value completed
+  VkImage getImage(int index) { return colorImages[index]; }
+  // graphics timeline value of the frame last rendered to image index, 0 if none yet
+  uint64_t getImageValue(int index) { return frameValues[index]; }
+
+  VkResult acquireNextImage(uint32_t *imageIndex) override;
+  VkResult submitCommandBuffers(
+      const VkCommandBuffer *buffers,
+      uint32_t *imageIndex,
+      const std::vector<VkeSemaphoreWait> &extraWaits = {}) override;
+
+ private:
+  void createColorResources();
+  void createDepthResources();
+  void createRenderPass();
+  void createFramebuffers();
+  VkFormat findDepthFormat();
+
+  VkDerkDevice &device;
+  VkExtent2D extent;
+
+  std::vector<VkImage> colorImages;
+  std::vector<VkeAllocation> colorImageMemory;
+  std::vector<VkImageView> colorImageViews;
+  std::vector<VkImage> depthImages;
+  VkeAllocation depthImageMemory;  // one allocation aliased by every depth image
+  std::vector<VkImageView> depthImageViews;
+  std::vector<VkFramebuffer> framebuffers;
+  VkRenderPass renderPass = VK_NULL_HANDLE;
+
+  std::vector<uint64_t> frameValues;  // graphics timeline value of the frame last submitted per slot
+  size_t currentFrame = 0;
+};
+
+}  // namespace vke
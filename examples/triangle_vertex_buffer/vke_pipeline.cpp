@@ -4,7 +4,10 @@
 #include <iostream>
 #include <stdexcept>
 #include <cstdio>
+#include <algorithm>
 #include <cassert>
+#include <cstring>
+#include <utility>
 
 namespace vke {
 
@@ -16,61 +19,61 @@ namespace vke {
 		const PipelineConfigInfo configInfo)
 		: vkDerkDevice{ device } {
 
-		createGraphicsPipeline(vertFilepath, fragFilepath, configInfo);
+		// Shader modules come from the device registry: a file already loaded by another pipeline is neither read nor compiled again
+		vertShaderModule = vkDerkDevice.shaderRegistry().load(vertFilepath);
+		fragShaderModule = vkDerkDevice.shaderRegistry().load(fragFilepath);
+		createGraphicsPipeline(configInfo);
 	}
 
-	VkePipeline::~VkePipeline() {
-		vkDestroyShaderModule(vkDerkDevice.device(), vertShaderModule, nullptr);
-		vkDestroyShaderModule(vkDerkDevice.device(), fragShaderModule, nullptr);
-		vkDestroyPipeline(vkDerkDevice.device(), graphicsPipeline, nullptr);
-	}
+	VkePipeline::VkePipeline(
+		VkDerkDevice& device,
+		VkeSpirvSpan vertCode,
+		VkeSpirvSpan fragCode,
+		const PipelineConfigInfo configInfo)
+		: vkDerkDevice{ device } {
 
-	// READ FILE FXN
-	std::vector<char> VkePipeline::readFile(const std::string& filepath) {
+		vertShaderModule = vkDerkDevice.shaderRegistry().get(vertCode);
+		fragShaderModule = vkDerkDevice.shaderRegistry().get(fragCode);
+		createGraphicsPipeline(configInfo);
+	}
 
-		// Input Stream Obj: ate = when file open, move to eof & binary = read file in as binary to avoid text transforms
-		std::ifstream file{ filepath, std::ios::ate | std::ios::binary };
+	VkePipeline::VkePipeline(
+		VkDerkDevice& device,
+		VkeShaderRegistry::Handle vertShader,
+		VkeShaderRegistry::Handle fragShader,
+		VkPipeline pipeline,
+		bool ownsPipeline)
+		: vkDerkDevice{ device }, graphicsPipeline{ pipeline }, ownsPipeline{ ownsPipeline }, vertShaderModule{ std::move(vertShader) }, fragShaderModule{ std::move(fragShader) } {
+	}
 
-		if (!file.is_open()) {
-			throw std::runtime_error("failed to open file: " + filepath);
+	VkePipeline::~VkePipeline() {
+		if (ownsPipeline) {
+			vkDestroyPipeline(vkDerkDevice.device(), graphicsPipeline, nullptr);
 		}
+	}
 
-		// Ate bit flag means that we are at end of file --> so tellg gives current position of file get pointer which is file size!
-		size_t fileSize = static_cast<size_t>(file.tellg());
-		// Initialize character buffer with size of file
-		std::vector<char> buffer(fileSize);
-
-		// Seek to front of file and read into buffer
-		file.seekg(0);
-		file.read(buffer.data(), fileSize);
+	void VkePipeline::createGraphicsPipeline(const PipelineConfigInfo& configInfo) {
 
-		file.close();
+		GraphicsPipelineCreateState state{};
+		state.config = configInfo;
+		populateCreateState(state, *vertShaderModule, *fragShaderModule);
 
-		return buffer;
+		// Device pipeline cache: pipelines compiled on an earlier run come back from disk instead of being recompiled
+		if (vkCreateGraphicsPipelines(vkDerkDevice.device(), vkDerkDevice.pipelineCache().handle(), 1, &state.pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create graphics pipeline");
+		}
 	}
 
-	// For now, just uses read file fxn to dump code into buffer
-	void VkePipeline::createGraphicsPipeline(const std::string& vertFilepath, const std::string& fragFilepath, const PipelineConfigInfo configInfo) {
+	void VkePipeline::populateCreateState(GraphicsPipelineCreateState& state, const VkeShaderModule& vertShader, const VkeShaderModule& fragShader) {
 
+		const PipelineConfigInfo& configInfo = state.config;
 		assert(configInfo.pipelineLayout != VK_NULL_HANDLE && "Cannot create graphics pipeline:: no pipelineLayout provided in configure");
 		assert(configInfo.renderPass != VK_NULL_HANDLE && "Cannot create graphics pipeline:: no renderPass provided in configure");
-		// Read in code
-		auto vertCode = readFile(vertFilepath);
-		auto fragCode = readFile(fragFilepath);
-
-		// Print vertex & fragment shadert code sizes
-		/*
-			std::cout << "Vertex Shader Code Size: " << vertCode.size() << '\n';
-			std::cout << "Fragment Shader Code Size: " << fragCode.size() << '\n';
-		*/
 
-		createShaderModule(vertCode, &vertShaderModule);
-		createShaderModule(fragCode, &fragShaderModule);
-
-		VkPipelineShaderStageCreateInfo shaderStages[2];
+		VkPipelineShaderStageCreateInfo* shaderStages = state.shaderStages;
 		shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 		shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-		shaderStages[0].module = vertShaderModule;
+		shaderStages[0].module = vertShader.handle();
 		shaderStages[0].pName = "main";
 		shaderStages[0].flags = 0;
 		shaderStages[0].pNext = nullptr;
@@ -78,31 +81,48 @@ namespace vke {
 
 		shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 		shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-		shaderStages[1].module = fragShaderModule;
+		shaderStages[1].module = fragShader.handle();
 		shaderStages[1].pName = "main";
 		shaderStages[1].flags = 0;
 		shaderStages[1].pNext = nullptr;
 		shaderStages[1].pSpecializationInfo = nullptr;
 
-		// UPDATED TO USE VERTEX BUFFERS
-		auto bindingDescriptions = VkeModel::Vertex::getBindingDescriptions();
-		auto attributeDescriptions = VkeModel::Vertex::getAttributeDescriptions();
+		// Specialization constants, only stages that have some get a VkSpecializationInfo
+		const VkeSpecializationConstants* stageConstants[2] = { &configInfo.vertSpecialization, &configInfo.fragSpecialization };
+		for (int stage = 0; stage < 2; stage++) {
+			if (stageConstants[stage]->empty()) {
+				continue;
+			}
+			stageConstants[stage]->fill(state.specializationInfos[stage], state.specializationEntries[stage], state.specializationData[stage]);
+			shaderStages[stage].pSpecializationInfo = &state.specializationInfos[stage];
+		}
 
-		VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+		// UPDATED TO USE VERTEX BUFFERS: descriptions come from the config so models and pipelines agree on the vertex layout
+		const auto& bindingDescriptions = configInfo.bindingDescriptions;
+		const auto& attributeDescriptions = configInfo.attributeDescriptions;
+
+		VkPipelineVertexInputStateCreateInfo& vertexInputInfo = state.vertexInputInfo;
+		vertexInputInfo = {};
 		vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 		vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());	
 		vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
 		vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 		vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
 
-		VkPipelineViewportStateCreateInfo viewportInfo{};
+		VkPipelineViewportStateCreateInfo& viewportInfo = state.viewportInfo;
+		viewportInfo = {};
 		viewportInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
 		viewportInfo.viewportCount = 1;
-		viewportInfo.pViewports = &configInfo.viewport;
+		viewportInfo.pViewports = nullptr;	// dynamic
 		viewportInfo.scissorCount = 1;
-		viewportInfo.pScissors = &configInfo.scissor;
+		viewportInfo.pScissors = nullptr;	// dynamic
+
+		// The config's blend state points at the attachment of whichever config it was filled in, re-point it at our own copy
+		state.colorBlendInfo = configInfo.colorBlendInfo;
+		state.colorBlendInfo.pAttachments = &configInfo.colorBlendAttachment;
 
-		VkGraphicsPipelineCreateInfo pipelineInfo{};
+		VkGraphicsPipelineCreateInfo& pipelineInfo = state.pipelineInfo;
+		pipelineInfo = {};
 		pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
 		pipelineInfo.stageCount = 2;	// (vert+frag)
 		pipelineInfo.pStages = shaderStages;
@@ -111,35 +131,161 @@ namespace vke {
 		pipelineInfo.pViewportState = &viewportInfo;
 		pipelineInfo.pRasterizationState = &configInfo.rasterizationInfo;
 		pipelineInfo.pMultisampleState = &configInfo.multisampleInfo;
-		pipelineInfo.pColorBlendState = &configInfo.colorBlendInfo;
+		pipelineInfo.pColorBlendState = &state.colorBlendInfo;
 		pipelineInfo.pDepthStencilState = &configInfo.depthStencilInfo;
 		pipelineInfo.pDynamicState = nullptr;
+		if (!configInfo.dynamicStateEnables.empty()) {
+			state.dynamicStateInfo = {};
+			state.dynamicStateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+			state.dynamicStateInfo.dynamicStateCount = static_cast<uint32_t>(configInfo.dynamicStateEnables.size());
+			state.dynamicStateInfo.pDynamicStates = configInfo.dynamicStateEnables.data();
+			pipelineInfo.pDynamicState = &state.dynamicStateInfo;
+		}
 
 		pipelineInfo.layout = configInfo.pipelineLayout;
 		pipelineInfo.renderPass = configInfo.renderPass;
 		pipelineInfo.subpass = configInfo.subpass;
 
-		// Associated with booting new pipelines from previous = maybe perf boosts. Deal with later
+		// Standalone pipeline. Derivatives of a base pipeline (booting new pipelines from previous) are VkePipelineLibrary's fallback
 		pipelineInfo.basePipelineIndex = -1;
 		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+	}
 
-		// TODO: understand / trace input variables better
-		if (vkCreateGraphicsPipelines(vkDerkDevice.device(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS) {
-			throw std::runtime_error("failed to create graphics pipeline");
-		}
+	namespace {
+
+		// Appends config fields to a key as 32 bit words
+		struct KeyWriter {
+			std::vector<uint32_t>& words;
+
+			void u32(uint32_t value) { words.push_back(value); }
+			void f32(float value) {
+				uint32_t bits;
+				std::memcpy(&bits, &value, sizeof(bits));
+				words.push_back(bits);
+			}
+			template <typename T>
+			void handle(T value) {
+				// non-dispatchable handles are pointers on 64 bit builds and uint64_t on 32 bit ones
+				uint64_t bits = 0;
+				std::memcpy(&bits, &value, sizeof(value));
+				words.push_back(static_cast<uint32_t>(bits));
+				words.push_back(static_cast<uint32_t>(bits >> 32));
+			}
+			void stencil(const VkStencilOpState& op) {
+				u32(op.failOp); u32(op.passOp); u32(op.depthFailOp); u32(op.compareOp);
+				u32(op.compareMask); u32(op.writeMask); u32(op.reference);
+			}
+		};
 
+	}
 
+	VkeSpecializationConstants& VkeSpecializationConstants::set(uint32_t constantId, float value) {
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		return setBits(constantId, Type::Float, bits);
 	}
 
-	void VkePipeline::createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule) {
-		VkShaderModuleCreateInfo createInfo{};
-		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-		createInfo.codeSize = code.size();
-		createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+	void VkeSpecializationConstants::fill(VkSpecializationInfo& info, std::vector<VkSpecializationMapEntry>& entries, std::vector<uint32_t>& data) const {
+		entries.clear();
+		data.clear();
+		for (const auto& constant : values_) {
+			VkSpecializationMapEntry entry{};
+			entry.constantID = constant.first;
+			entry.offset = static_cast<uint32_t>(data.size() * sizeof(uint32_t));
+			entry.size = sizeof(uint32_t);
+			entries.push_back(entry);
+			data.push_back(constant.second.bits);
+		}
 
-		if (vkCreateShaderModule(vkDerkDevice.device(), &createInfo, nullptr, shaderModule) != VK_SUCCESS) {
-			throw std::runtime_error("failed to create shader module");
+		info.mapEntryCount = static_cast<uint32_t>(entries.size());
+		info.pMapEntries = entries.data();
+		info.dataSize = data.size() * sizeof(uint32_t);
+		info.pData = data.data();
+	}
+
+	PipelineConfigKey PipelineConfigKey::from(const PipelineConfigInfo& configInfo) {
+		PipelineConfigKey key{};
+		key.words.reserve(96);
+		KeyWriter w{ key.words };
+
+		// Dynamic states first (sorted, order doesn't matter to the driver), values they cover are skipped below
+		std::vector<VkDynamicState> dynamicStates = configInfo.dynamicStateEnables;
+		std::sort(dynamicStates.begin(), dynamicStates.end());
+		dynamicStates.erase(std::unique(dynamicStates.begin(), dynamicStates.end()), dynamicStates.end());
+		w.u32(static_cast<uint32_t>(dynamicStates.size()));
+		for (VkDynamicState dynamicState : dynamicStates) {
+			w.u32(static_cast<uint32_t>(dynamicState));
+		}
+		auto isStatic = [&](VkDynamicState dynamicState) {
+			return !std::binary_search(dynamicStates.begin(), dynamicStates.end(), dynamicState);
+		};
+
+		const auto& ia = configInfo.inputAssemblyInfo;
+		w.u32(ia.topology); w.u32(ia.primitiveRestartEnable);
+
+		const auto& rs = configInfo.rasterizationInfo;
+		w.u32(rs.depthClampEnable); w.u32(rs.rasterizerDiscardEnable); w.u32(rs.polygonMode);
+		if (isStatic(VK_DYNAMIC_STATE_CULL_MODE_EXT)) { w.u32(rs.cullMode); }
+		if (isStatic(VK_DYNAMIC_STATE_FRONT_FACE_EXT)) { w.u32(rs.frontFace); }
+		w.u32(rs.depthBiasEnable);
+		w.f32(rs.depthBiasConstantFactor); w.f32(rs.depthBiasClamp); w.f32(rs.depthBiasSlopeFactor);
+		if (isStatic(VK_DYNAMIC_STATE_LINE_WIDTH)) { w.f32(rs.lineWidth); }
+
+		const auto& ms = configInfo.multisampleInfo;
+		w.u32(ms.rasterizationSamples); w.u32(ms.sampleShadingEnable); w.f32(ms.minSampleShading);
+		w.u32(ms.alphaToCoverageEnable); w.u32(ms.alphaToOneEnable);
+		w.u32(ms.pSampleMask != nullptr);
+		if (ms.pSampleMask != nullptr) {
+			for (uint32_t i = 0; i < (static_cast<uint32_t>(ms.rasterizationSamples) + 31) / 32; i++) {
+				w.u32(ms.pSampleMask[i]);
+			}
 		}
+
+		const auto& cba = configInfo.colorBlendAttachment;
+		w.u32(cba.blendEnable); w.u32(cba.srcColorBlendFactor); w.u32(cba.dstColorBlendFactor); w.u32(cba.colorBlendOp);
+		w.u32(cba.srcAlphaBlendFactor); w.u32(cba.dstAlphaBlendFactor); w.u32(cba.alphaBlendOp); w.u32(cba.colorWriteMask);
+
+		const auto& cb = configInfo.colorBlendInfo;
+		w.u32(cb.logicOpEnable); w.u32(cb.logicOp); w.u32(cb.attachmentCount);
+		for (float constant : cb.blendConstants) {
+			w.f32(constant);
+		}
+
+		const auto& ds = configInfo.depthStencilInfo;
+		if (isStatic(VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE_EXT)) { w.u32(ds.depthTestEnable); }
+		if (isStatic(VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE_EXT)) { w.u32(ds.depthWriteEnable); }
+		if (isStatic(VK_DYNAMIC_STATE_DEPTH_COMPARE_OP_EXT)) { w.u32(ds.depthCompareOp); }
+		w.u32(ds.depthBoundsTestEnable); w.f32(ds.minDepthBounds); w.f32(ds.maxDepthBounds);
+		w.u32(ds.stencilTestEnable); w.stencil(ds.front); w.stencil(ds.back);
+
+		w.u32(static_cast<uint32_t>(configInfo.bindingDescriptions.size()));
+		for (const auto& binding : configInfo.bindingDescriptions) {
+			w.u32(binding.binding); w.u32(binding.stride); w.u32(binding.inputRate);
+		}
+		w.u32(static_cast<uint32_t>(configInfo.attributeDescriptions.size()));
+		for (const auto& attribute : configInfo.attributeDescriptions) {
+			w.u32(attribute.location); w.u32(attribute.binding); w.u32(attribute.format); w.u32(attribute.offset);
+		}
+
+		for (const VkeSpecializationConstants* constants : { &configInfo.vertSpecialization, &configInfo.fragSpecialization }) {
+			w.u32(static_cast<uint32_t>(constants->values().size()));
+			for (const auto& constant : constants->values()) {
+				w.u32(constant.first);
+				w.u32(static_cast<uint32_t>(constant.second.type));
+				w.u32(constant.second.bits);
+			}
+		}
+
+		w.handle(configInfo.pipelineLayout);
+		w.handle(configInfo.renderPass);
+		w.u32(configInfo.subpass);
+
+		key.hash = VkeShaderRegistry::hashCode(key.words.data(), key.words.size() * sizeof(uint32_t));
+		return key;
+	}
+
+	bool operator == (const PipelineConfigInfo& a, const PipelineConfigInfo& b) {
+		return PipelineConfigKey::from(a) == PipelineConfigKey::from(b);
 	}
 
 	void VkePipeline::bind(VkCommandBuffer commandBuffer) {
@@ -147,7 +293,7 @@ namespace vke {
 		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
 	}
 
-	void VkePipeline::defaultPipelineConfigInfo(PipelineConfigInfo& configInfo, uint32_t width, uint32_t height) {
+	void VkePipeline::defaultPipelineConfigInfo(PipelineConfigInfo& configInfo) {
 		//PipelineConfigInfo configInfo{};
 
 		// First stage of pipeline. Recieves input list and converts it to geometry.
@@ -157,17 +303,9 @@ namespace vke {
 		configInfo.inputAssemblyInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
 		configInfo.inputAssemblyInfo.primitiveRestartEnable = VK_FALSE;
 
-		// Configure viewport: viewport describes transformation from pipeline output to target image
-		configInfo.viewport.x = 0.0f;
-		configInfo.viewport.y = 0.0f;
-		configInfo.viewport.width = static_cast<float>(width);
-		configInfo.viewport.height = static_cast<float>(height);
-		configInfo.viewport.minDepth = 0.0f;
-		configInfo.viewport.maxDepth = 1.0f;
-
-		// Configure Scissor: cuts image output accordingly
-		configInfo.scissor.offset = { 0, 0 };
-		configInfo.scissor.extent = { width, height };
+		// Viewport (transformation from pipeline output to target image) & scissor (cuts image output) are set per command buffer:
+		// an extent change or dynamic resolution scaling costs no pipeline compile. See setViewportAndScissor
+		configInfo.dynamicStateEnables = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
 
 		// RASTERIZATION STAGE
 		configInfo.rasterizationInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
@@ -226,7 +364,47 @@ namespace vke {
 		configInfo.depthStencilInfo.front = {};	//optional
 		configInfo.depthStencilInfo.back = {};	//optional
 
+		// Vertex input: plain float2 positions, what simple_shader.vert reads at location 0
+		configInfo.bindingDescriptions = VkeModel::Vertex::getBindingDescriptions();
+		configInfo.attributeDescriptions = VkeModel::Vertex::getAttributeDescriptions();
+
 		//return configInfo;
 	}
 
+	void VkePipeline::enableExtendedDynamicState(PipelineConfigInfo& configInfo) {
+		for (VkDynamicState state : { VK_DYNAMIC_STATE_CULL_MODE_EXT, VK_DYNAMIC_STATE_FRONT_FACE_EXT, VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE_EXT,
+				VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE_EXT, VK_DYNAMIC_STATE_DEPTH_COMPARE_OP_EXT }) {
+			if (!hasDynamicState(configInfo, state)) {
+				configInfo.dynamicStateEnables.push_back(state);
+			}
+		}
+	}
+
+	bool VkePipeline::hasDynamicState(const PipelineConfigInfo& configInfo, VkDynamicState state) {
+		return std::find(configInfo.dynamicStateEnables.begin(), configInfo.dynamicStateEnables.end(), state) != configInfo.dynamicStateEnables.end();
+	}
+
+	void VkePipeline::setViewportAndScissor(VkCommandBuffer commandBuffer, VkExtent2D extent) {
+		VkViewport viewport{};
+		viewport.x = 0.0f;
+		viewport.y = 0.0f;
+		viewport.width = static_cast<float>(extent.width);
+		viewport.height = static_cast<float>(extent.height);
+		viewport.minDepth = 0.0f;
+		viewport.maxDepth = 1.0f;
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+		VkRect2D scissor{ { 0, 0 }, extent };
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+	}
+
+	void VkePipeline::setExtendedDynamicState(VkCommandBuffer commandBuffer, const VkeExtendedDynamicStateFns& fns, const PipelineConfigInfo& configInfo) {
+		assert(fns.supported() && "VK_EXT_extended_dynamic_state not enabled on this device");
+		fns.setCullMode(commandBuffer, configInfo.rasterizationInfo.cullMode);
+		fns.setFrontFace(commandBuffer, configInfo.rasterizationInfo.frontFace);
+		fns.setDepthTestEnable(commandBuffer, configInfo.depthStencilInfo.depthTestEnable);
+		fns.setDepthWriteEnable(commandBuffer, configInfo.depthStencilInfo.depthWriteEnable);
+		fns.setDepthCompareOp(commandBuffer, configInfo.depthStencilInfo.depthCompareOp);
+	}
+
 }
\ No newline at end of file
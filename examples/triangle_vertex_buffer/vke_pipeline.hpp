@@ -1,16 +1,49 @@
 #pragma once
 
+#include <cstdint>
+#include <map>
 #include <string>
 #include <vector>
 #include "vk_derk_device.hpp"
 
 namespace vke{
 
+	// Specialization constant values for one shader stage, keyed by constant_id (layout(constant_id = N) in GLSL).
+	// Every supported type is 32 bits wide, bools are stored as VkBool32 like the spec wants.
+	// Ex: light counts, feature toggles, unroll sizes -> one SPIR-V file, the driver compiles a specialized variant per value set
+	class VkeSpecializationConstants {
+		public:
+			enum class Type : uint32_t { Bool, Int, Uint, Float };
+			struct Value {
+				Type type;
+				uint32_t bits;
+			};
+
+			VkeSpecializationConstants& set(uint32_t constantId, bool value) { return setBits(constantId, Type::Bool, value ? VK_TRUE : VK_FALSE); }
+			VkeSpecializationConstants& set(uint32_t constantId, int32_t value) { return setBits(constantId, Type::Int, static_cast<uint32_t>(value)); }
+			VkeSpecializationConstants& set(uint32_t constantId, uint32_t value) { return setBits(constantId, Type::Uint, value); }
+			VkeSpecializationConstants& set(uint32_t constantId, float value);
+			void erase(uint32_t constantId) { values_.erase(constantId); }
+
+			bool empty() const { return values_.empty(); }
+			// sorted by constant_id, so equal sets always produce the same map entries and key
+			const std::map<uint32_t, Value>& values() const { return values_; }
+			// One 32 bit slot of data per constant, in constant_id order. entries & data back info and must outlive it
+			void fill(VkSpecializationInfo& info, std::vector<VkSpecializationMapEntry>& entries, std::vector<uint32_t>& data) const;
+
+		private:
+			VkeSpecializationConstants& setBits(uint32_t constantId, Type type, uint32_t bits) {
+				values_[constantId] = Value{ type, bits };
+				return *this;
+			}
+
+			std::map<uint32_t, Value> values_;
+	};
+
 	// Contain data specifying pipe config. 
 	// Pulling out of pipe class so app layer code can configure pipe and share w/ other pipes
 	struct PipelineConfigInfo {
-		VkViewport viewport;
-		VkRect2D scissor;
+		// Viewport & scissor are dynamic state (set per command buffer), so the swap chain extent never reaches the pipeline
 		//Has an issue, deleted: VkPipelineViewportStateCreateInfo viewportInfo;
 		VkPipelineInputAssemblyStateCreateInfo inputAssemblyInfo;
 		VkPipelineRasterizationStateCreateInfo rasterizationInfo;
@@ -18,9 +51,54 @@ namespace vke{
 		VkPipelineColorBlendAttachmentState colorBlendAttachment;
 		VkPipelineColorBlendStateCreateInfo colorBlendInfo;
 		VkPipelineDepthStencilStateCreateInfo depthStencilInfo;
+		// Vertex input: defaults to VkeModel's default layout, set from VkeVertexLayout for quantized models
+		std::vector<VkVertexInputBindingDescription> bindingDescriptions;
+		std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
 		VkPipelineLayout pipelineLayout = nullptr;
 		VkRenderPass renderPass = nullptr;
 		uint32_t subpass = 0;
+		// State set while recording instead of baked in. Fields covered here are ignored by the pipeline and left out of its key
+		std::vector<VkDynamicState> dynamicStateEnables;
+		// Per stage shader specialization, part of the pipeline key
+		VkeSpecializationConstants vertSpecialization;
+		VkeSpecializationConstants fragSpecialization;
+	};
+
+	// Flattened copy of every PipelineConfigInfo field that ends up in the compiled pipeline (floats as bit patterns,
+	// handles by value, nothing behind a pointer), so configs can be hashed and compared without padding or pointer noise.
+	// Two configs with equal keys build the same pipeline.
+	struct PipelineConfigKey {
+		std::vector<uint32_t> words;
+		uint64_t hash = 0;	// FNV-1a over words
+
+		static PipelineConfigKey from(const PipelineConfigInfo& configInfo);
+
+		bool operator == (const PipelineConfigKey& other) const { return hash == other.hash && words == other.words; }
+		bool operator != (const PipelineConfigKey& other) const { return !(*this == other); }
+	};
+
+	bool operator == (const PipelineConfigInfo& a, const PipelineConfigInfo& b);
+	inline bool operator != (const PipelineConfigInfo& a, const PipelineConfigInfo& b) { return !(a == b); }
+
+	// Everything a VkGraphicsPipelineCreateInfo points at, owned in one place so several can be filled
+	// and handed to a single vkCreateGraphicsPipelines call (VkePipelineBuilder batches this way).
+	// pipelineInfo points into the struct itself: fill it where it will stay, don't copy or move it afterwards.
+	struct GraphicsPipelineCreateState {
+		PipelineConfigInfo config;
+		VkPipelineShaderStageCreateInfo shaderStages[2];
+		// per stage specialization, what shaderStages[i].pSpecializationInfo points at when the stage has constants
+		VkSpecializationInfo specializationInfos[2];
+		std::vector<VkSpecializationMapEntry> specializationEntries[2];
+		std::vector<uint32_t> specializationData[2];
+		VkPipelineVertexInputStateCreateInfo vertexInputInfo;
+		VkPipelineViewportStateCreateInfo viewportInfo;
+		VkPipelineColorBlendStateCreateInfo colorBlendInfo;
+		VkPipelineDynamicStateCreateInfo dynamicStateInfo;
+		VkGraphicsPipelineCreateInfo pipelineInfo;
+
+		GraphicsPipelineCreateState() = default;
+		GraphicsPipelineCreateState(const GraphicsPipelineCreateState&) = delete;
+		GraphicsPipelineCreateState& operator = (const GraphicsPipelineCreateState&) = delete;
 	};
 
 	class VkePipeline {
@@ -34,6 +112,23 @@ namespace vke{
 				const std::string& fragFilepath, 
 				const PipelineConfigInfo configInfo
 			);
+			// SPIR-V already in memory (build time embedded shaders): no file is opened
+			VkePipeline(
+				VkDerkDevice &device,
+				VkeSpirvSpan vertCode,
+				VkeSpirvSpan fragCode,
+				const PipelineConfigInfo configInfo
+			);
+
+			// Adopts a pipeline built elsewhere from these modules (VkePipelineBuilder), destroyed with this object.
+			// ownsPipeline false: the handle stays with its creator (a VkePipelineLibrary derivative base)
+			VkePipeline(
+				VkDerkDevice &device,
+				VkeShaderRegistry::Handle vertShader,
+				VkeShaderRegistry::Handle fragShader,
+				VkPipeline pipeline,
+				bool ownsPipeline = true
+			);
 
 			~VkePipeline();
 
@@ -42,19 +137,23 @@ namespace vke{
 			void operator = (const VkePipeline&) = delete;
 
 			void bind(VkCommandBuffer commandBuffer);
-			static void defaultPipelineConfigInfo(PipelineConfigInfo& configInfo, uint32_t width, uint32_t height);
+			VkPipeline handle() const { return graphicsPipeline; }
+			static void defaultPipelineConfigInfo(PipelineConfigInfo& configInfo);
+			// Also make cull mode, front face and the depth test dynamic (VK_EXT_extended_dynamic_state, check VkDerkDevice support first).
+			// Pipelines that only differed in those then share one key, the values come from setExtendedDynamicState
+			static void enableExtendedDynamicState(PipelineConfigInfo& configInfo);
+			static bool hasDynamicState(const PipelineConfigInfo& configInfo, VkDynamicState state);
+
+			// Full extent viewport & scissor, call after binding a pipeline with dynamic viewport/scissor
+			static void setViewportAndScissor(VkCommandBuffer commandBuffer, VkExtent2D extent);
+			// Records configInfo's cull / front face / depth values as dynamic state
+			static void setExtendedDynamicState(VkCommandBuffer commandBuffer, const VkeExtendedDynamicStateFns& fns, const PipelineConfigInfo& configInfo);
+			// Fills state.pipelineInfo from state.config and the two modules, state.config must already be set
+			static void populateCreateState(GraphicsPipelineCreateState& state, const VkeShaderModule& vertShader, const VkeShaderModule& fragShader);
 			
 		private:
-			static std::vector<char> readFile(const std::string& filepath);
-
-			void createGraphicsPipeline(
-				const std::string& vertFilepath, 
-				const std::string& fragFilepath,
-				const PipelineConfigInfo conigInfo
-			);
-
-			// Input vars: character vector and pointer to shader module (vkshadermodule is a pointer, so double pointer!)
-			void createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule);
+			// Expects vertShaderModule/fragShaderModule to be set
+			void createGraphicsPipeline(const PipelineConfigInfo& configInfo);
 
 			// Member var storing device reference
 			// Could be memory unsafe: if device is freed before pipeline, this would be a dangling pointer (derefrence = crash)
@@ -62,8 +161,10 @@ namespace vke{
 			VkDerkDevice& vkDerkDevice;
 
 			VkPipeline graphicsPipeline;		
-			VkShaderModule vertShaderModule;
-			VkShaderModule fragShaderModule;
+			bool ownsPipeline = true;
+			// Shared through the device's shader registry: released (not destroyed) with the pipeline
+			VkeShaderRegistry::Handle vertShaderModule;
+			VkeShaderRegistry::Handle fragShaderModule;
 	};
 
 }
\ No newline at end of file
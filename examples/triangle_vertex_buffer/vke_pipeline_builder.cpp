@@ -0,0 +1,212 @@
+#include "vke_pipeline_builder.hpp"
+
+// std headers
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+#include <utility>
+
+namespace vke {
+
+VkePipelineBuilder::VkePipelineBuilder(
+    VkDerkDevice &device, unsigned workerCount, size_t maxBatchSize)
+    : device{device}, maxBatchSize{std::max<size_t>(maxBatchSize, 1)} {
+  if (workerCount == 0) {
+    workerCount = std::max(std::thread::hardware_concurrency(), 1u);
+  }
+  workers.reserve(workerCount);
+  for (unsigned i = 0; i < workerCount; i++) {
+    workers.emplace_back([this] { workerLoop(); });
+  }
+}
+
+VkePipelineBuilder::~VkePipelineBuilder() {
+  {
+    std::lock_guard<std::mutex> lock{mutex};
+    stopping = true;
+  }
+  workAvailable.notify_all();
+  for (auto &worker : workers) {
+    worker.join();
+  }
+}
+
+VkePipelineBuilder::Result VkePipelineBuilder::submit(
+    const std::string &vertFilepath,
+    const std::string &fragFilepath,
+    const PipelineConfigInfo &configInfo) {
+  auto job = std::make_unique<Job>();
+  job->vertFilepath = vertFilepath;
+  job->fragFilepath = fragFilepath;
+  job->configInfo = configInfo;
+  return enqueue(std::move(job));
+}
+
+VkePipelineBuilder::Result VkePipelineBuilder::submit(
+    VkeSpirvSpan vertCode, VkeSpirvSpan fragCode, const PipelineConfigInfo &configInfo) {
+  auto job = std::make_unique<Job>();
+  job->vertCode = vertCode;
+  job->fragCode = fragCode;
+  job->configInfo = configInfo;
+  return enqueue(std::move(job));
+}
+
+VkePipelineBuilder::Result VkePipelineBuilder::submit(
+    VkeShaderRegistry::Handle vertShader,
+    VkeShaderRegistry::Handle fragShader,
+    const PipelineConfigInfo &configInfo) {
+  auto job = std::make_unique<Job>();
+  job->vertShader = std::move(vertShader);
+  job->fragShader = std::move(fragShader);
+  job->configInfo = configInfo;
+  return enqueue(std::move(job));
+}
+
+VkePipelineBuilder::Result VkePipelineBuilder::enqueue(std::unique_ptr<Job> job) {
+  Result result = job->promise.get_future();
+  {
+    std::lock_guard<std::mutex> lock{mutex};
+    queue.push_back(std::move(job));
+  }
+  workAvailable.notify_one();
+  return result;
+}
+
+void VkePipelineBuilder::waitIdle() {
+  std::unique_lock<std::mutex> lock{mutex};
+  idle.wait(lock, [this] { return queue.empty() && busyWorkers == 0; });
+}
+
+size_t VkePipelineBuilder::pendingCount() {
+  std::lock_guard<std::mutex> lock{mutex};
+  return queue.size() + busyWorkers;
+}
+
+void VkePipelineBuilder::workerLoop() {
+  std::vector<std::unique_ptr<Job>> batch;
+  for (;;) {
+    bool moreQueued = false;
+    {
+      std::unique_lock<std::mutex> lock{mutex};
+      workAvailable.wait(lock, [this] { return stopping || !queue.empty(); });
+      if (queue.empty()) {
+        return;  // stopping and drained
+      }
+
+      // split what's queued evenly over the workers so a burst of submits keeps every core busy,
+      // capped so one call doesn't hold a large share of the work hostage
+      size_t share = (queue.size() + workers.size() - 1) / workers.size();
+      size_t count = std::min(std::max<size_t>(share, 1), maxBatchSize);
+      for (size_t i = 0; i < count; i++) {
+        batch.push_back(std::move(queue.front()));
+        queue.pop_front();
+      }
+      busyWorkers++;
+      moreQueued = !queue.empty();
+    }
+    if (moreQueued) {
+      workAvailable.notify_one();
+    }
+
+    build(batch);
+    batch.clear();
+
+    {
+      std::lock_guard<std::mutex> lock{mutex};
+      busyWorkers--;
+    }
+    idle.notify_all();
+  }
+}
+
+VkeShaderRegistry::Handle VkePipelineBuilder::loadShader(
+    VkeShaderRegistry::Handle module, const std::string &filepath, VkeSpirvSpan code) {
+  if (module) {
+    return module;
+  }
+  if (code.data != nullptr) {
+    return device.shaderRegistry().get(code);
+  }
+  return device.shaderRegistry().load(filepath);
+}
+
+void VkePipelineBuilder::build(std::vector<std::unique_ptr<Job>> &batch) {
+  struct Pending {
+    Job *job;
+    VkeShaderRegistry::Handle vertShader;
+    VkeShaderRegistry::Handle fragShader;
+    std::unique_ptr<GraphicsPipelineCreateState> state;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+  };
+
+  std::vector<Pending> pending;
+  pending.reserve(batch.size());
+  for (auto &job : batch) {
+    Pending entry{job.get()};
+    try {
+      entry.vertShader = loadShader(std::move(job->vertShader), job->vertFilepath, job->vertCode);
+      entry.fragShader = loadShader(std::move(job->fragShader), job->fragFilepath, job->fragCode);
+    } catch (...) {
+      job->promise.set_exception(std::current_exception());
+      continue;
+    }
+    // create state points into itself, so it lives on the heap where it won't move
+    entry.state = std::make_unique<GraphicsPipelineCreateState>();
+    entry.state->config = std::move(job->configInfo);
+    VkePipeline::populateCreateState(*entry.state, *entry.vertShader, *entry.fragShader);
+    pending.push_back(std::move(entry));
+  }
+  if (pending.empty()) {
+    return;
+  }
+
+  std::vector<VkGraphicsPipelineCreateInfo> createInfos;
+  createInfos.reserve(pending.size());
+  for (auto &entry : pending) {
+    createInfos.push_back(entry.state->pipelineInfo);
+  }
+  std::vector<VkPipeline> pipelines(pending.size(), VK_NULL_HANDLE);
+
+  VkDevice vkDevice = device.device();
+  VkPipelineCache cache = device.pipelineCache().handle();
+  VkResult result = vkCreateGraphicsPipelines(
+      vkDevice,
+      cache,
+      static_cast<uint32_t>(createInfos.size()),
+      createInfos.data(),
+      nullptr,
+      pipelines.data());
+
+  if (result == VK_SUCCESS) {
+    for (size_t i = 0; i < pending.size(); i++) {
+      pending[i].pipeline = pipelines[i];
+    }
+  } else {
+    // a batch fails as a whole: drop whatever did get built and redo them one by one, so only the
+    // jobs that actually fail get an error
+    for (VkPipeline pipeline : pipelines) {
+      if (pipeline != VK_NULL_HANDLE) {
+        vkDestroyPipeline(vkDevice, pipeline, nullptr);
+      }
+    }
+    for (auto &entry : pending) {
+      if (vkCreateGraphicsPipelines(
+              vkDevice, cache, 1, &entry.state->pipelineInfo, nullptr, &entry.pipeline) !=
+          VK_SUCCESS) {
+        entry.pipeline = VK_NULL_HANDLE;
+      }
+    }
+  }
+
+  for (auto &entry : pending) {
+    if (entry.pipeline == VK_NULL_HANDLE) {
+      entry.job->promise.set_exception(
+          std::make_exception_ptr(std::runtime_error("failed to create graphics pipeline")));
+      continue;
+    }
+    entry.job->promise.set_value(std::make_unique<VkePipeline>(
+        device, std::move(entry.vertShader), std::move(entry.fragShader), entry.pipeline));
+  }
+}
+
+}  // namespace vke
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "vke_pipeline.hpp"
+
+// std lib headers
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace vke {
+
+// Pipeline build queue. Submitted config + shader pairs are compiled on a pool of worker threads,
+// each worker takes a batch of jobs off the queue and creates them with one vkCreateGraphicsPipelines
+// call through the device pipeline cache (internally synchronized, so workers share it). Shader
+// modules are resolved on the workers through the device shader registry. Every submit returns a
+// future for its pipeline; a failed build surfaces as the std::runtime_error from future::get().
+//
+// Jobs still queued when the builder is destroyed are built first, outstanding futures never break.
+class VkePipelineBuilder {
+ public:
+  using Result = std::future<std::unique_ptr<VkePipeline>>;
+
+  static constexpr size_t DEFAULT_MAX_BATCH_SIZE = 16;
+
+  // workerCount 0 = one per hardware thread
+  explicit VkePipelineBuilder(
+      VkDerkDevice &device, unsigned workerCount = 0, size_t maxBatchSize = DEFAULT_MAX_BATCH_SIZE);
+  ~VkePipelineBuilder();
+
+  VkePipelineBuilder(const VkePipelineBuilder &) = delete;
+  VkePipelineBuilder &operator=(const VkePipelineBuilder &) = delete;
+
+  Result submit(
+      const std::string &vertFilepath,
+      const std::string &fragFilepath,
+      const PipelineConfigInfo &configInfo);
+  // the words must stay alive until the future is ready (embedded shaders always do)
+  Result submit(VkeSpirvSpan vertCode, VkeSpirvSpan fragCode, const PipelineConfigInfo &configInfo);
+  // modules already resolved by the caller (VkePipelineRegistry needs their hashes up front)
+  Result submit(
+      VkeShaderRegistry::Handle vertShader,
+      VkeShaderRegistry::Handle fragShader,
+      const PipelineConfigInfo &configInfo);
+
+  // blocks until the queue is empty and no worker is busy
+  void waitIdle();
+
+  size_t pendingCount();
+  unsigned workerCount() const { return static_cast<unsigned>(workers.size()); }
+
+ private:
+  struct Job {
+    std::string vertFilepath;
+    std::string fragFilepath;
+    VkeSpirvSpan vertCode;
+    VkeSpirvSpan fragCode;
+    VkeShaderRegistry::Handle vertShader;
+    VkeShaderRegistry::Handle fragShader;
+    PipelineConfigInfo configInfo;
+    std::promise<std::unique_ptr<VkePipeline>> promise;
+  };
+
+  Result enqueue(std::unique_ptr<Job> job);
+  void workerLoop();
+  void build(std::vector<std::unique_ptr<Job>> &batch);
+  VkeShaderRegistry::Handle loadShader(
+      VkeShaderRegistry::Handle module, const std::string &filepath, VkeSpirvSpan code);
+
+  VkDerkDevice &device;
+  size_t maxBatchSize;
+
+  std::deque<std::unique_ptr<Job>> queue;
+  size_t busyWorkers = 0;
+  bool stopping = false;
+  std::mutex mutex;
+  std::condition_variable workAvailable;
+  std::condition_variable idle;
+
+  std::vector<std::thread> workers;
+};
+
+}  // namespace vke
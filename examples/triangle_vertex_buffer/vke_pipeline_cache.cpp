@@ -0,0 +1,132 @@
+#include "vke_pipeline_cache.hpp"
+
+// std headers
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <system_error>
+
+namespace vke {
+
+namespace {
+
+// cache header fields are stored least significant byte first
+uint32_t readLittleEndian32(const std::vector<char> &data, size_t offset) {
+  const auto *bytes = reinterpret_cast<const unsigned char *>(data.data() + offset);
+  return static_cast<uint32_t>(bytes[0]) | (static_cast<uint32_t>(bytes[1]) << 8) |
+         (static_cast<uint32_t>(bytes[2]) << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+}
+
+}  // namespace
+
+VkePipelineCache::VkePipelineCache(
+    VkDevice device, const VkPhysicalDeviceProperties &properties, const std::string &path)
+    : device{device}, properties{properties}, path{path} {
+  std::vector<char> data = readCacheFile();
+  if (!data.empty() && !isCompatible(data)) {
+    std::cout << "pipeline cache: " << path << " is stale or corrupt, starting empty" << std::endl;
+    data.clear();
+  }
+
+  VkPipelineCacheCreateInfo createInfo{};
+  createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  createInfo.initialDataSize = data.size();
+  createInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+  VkResult result = vkCreatePipelineCache(device, &createInfo, nullptr, &cache);
+  if (result != VK_SUCCESS && !data.empty()) {
+    // the header checked out but the driver still refused the payload
+    createInfo.initialDataSize = 0;
+    createInfo.pInitialData = nullptr;
+    data.clear();
+    result = vkCreatePipelineCache(device, &createInfo, nullptr, &cache);
+  }
+  if (result != VK_SUCCESS) {
+    throw std::runtime_error("failed to create pipeline cache!");
+  }
+
+  loaded = !data.empty();
+  savedSize = data.size();
+}
+
+VkePipelineCache::~VkePipelineCache() {
+  save();
+  vkDestroyPipelineCache(device, cache, nullptr);
+}
+
+std::vector<char> VkePipelineCache::readCacheFile() const {
+  std::ifstream file{path, std::ios::ate | std::ios::binary};
+  if (!file.is_open()) {
+    return {};  // first run
+  }
+
+  std::streamoff fileSize = file.tellg();
+  if (fileSize <= 0) {
+    return {};
+  }
+  std::vector<char> data(static_cast<size_t>(fileSize));
+  file.seekg(0);
+  if (!file.read(data.data(), fileSize)) {
+    return {};
+  }
+  return data;
+}
+
+bool VkePipelineCache::isCompatible(const std::vector<char> &data) const {
+  if (data.size() < HEADER_SIZE) {
+    return false;
+  }
+
+  uint32_t headerLength = readLittleEndian32(data, 0);
+  uint32_t headerVersion = readLittleEndian32(data, 4);
+  uint32_t vendorID = readLittleEndian32(data, 8);
+  uint32_t deviceID = readLittleEndian32(data, 12);
+
+  return headerLength >= HEADER_SIZE && headerLength <= data.size() &&
+         headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+         vendorID == properties.vendorID && deviceID == properties.deviceID &&
+         memcmp(data.data() + 16, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+bool VkePipelineCache::save() {
+  std::lock_guard<std::mutex> lock{mutex};
+
+  size_t dataSize = 0;
+  if (vkGetPipelineCacheData(device, cache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0 ||
+      dataSize == savedSize) {
+    return false;  // caches only grow, same size means nothing new was compiled
+  }
+
+  std::vector<char> data(dataSize);
+  if (vkGetPipelineCacheData(device, cache, &dataSize, data.data()) != VK_SUCCESS) {
+    return false;
+  }
+  data.resize(dataSize);
+
+  // write the whole file under a temp name, then swap it in with one rename
+  std::string tmpPath = path + ".tmp";
+  {
+    std::ofstream file{tmpPath, std::ios::binary | std::ios::trunc};
+    if (!file.is_open() || !file.write(data.data(), static_cast<std::streamsize>(data.size())) ||
+        !file.flush()) {
+      std::cout << "pipeline cache: failed to write " << tmpPath << std::endl;
+      return false;
+    }
+  }
+
+  std::error_code error;
+  std::filesystem::rename(tmpPath, path, error);
+  if (error) {
+    std::cout << "pipeline cache: failed to replace " << path << ": " << error.message()
+              << std::endl;
+    std::filesystem::remove(tmpPath, error);
+    return false;
+  }
+
+  savedSize = dataSize;
+  return true;
+}
+
+}  // namespace vke
@@ -0,0 +1,53 @@
+#pragma once
+
+// vulkan headers
+#include <vulkan/vulkan.h>
+
+// std lib headers
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace vke {
+
+// VkPipelineCache persisted between runs. The file is only handed to the driver when its header
+// matches this device (vendorID, deviceID, pipelineCacheUUID); anything else (other GPU, new
+// driver, truncated or corrupt file) starts from an empty cache. Saving writes a temp file next to
+// the target and renames it over, so a crash mid-save never leaves a half written cache behind.
+class VkePipelineCache {
+ public:
+  VkePipelineCache(
+      VkDevice device, const VkPhysicalDeviceProperties &properties, const std::string &path);
+  ~VkePipelineCache();
+
+  VkePipelineCache(const VkePipelineCache &) = delete;
+  VkePipelineCache &operator=(const VkePipelineCache &) = delete;
+
+  VkPipelineCache handle() { return cache; }
+
+  // Writes the cache if the driver's data changed size since the last save. Returns true if written.
+  bool save();
+
+  // true if the file on disk was accepted at startup
+  bool loadedFromDisk() const { return loaded; }
+
+ private:
+  // offset 0 header length, 4 header version, 8 vendorID, 12 deviceID, 16 pipelineCacheUUID
+  static constexpr size_t HEADER_SIZE = 16 + VK_UUID_SIZE;
+
+  bool isCompatible(const std::vector<char> &data) const;
+  std::vector<char> readCacheFile() const;
+
+  VkDevice device;
+  VkPhysicalDeviceProperties properties;
+  std::string path;
+
+  VkPipelineCache cache = VK_NULL_HANDLE;
+  bool loaded = false;
+  size_t savedSize = 0;
+  std::mutex mutex;
+};
+
+}  // namespace vke
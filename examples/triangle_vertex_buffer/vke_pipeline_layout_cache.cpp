@@ -0,0 +1,85 @@
+#include "vke_pipeline_layout_cache.hpp"
+
+// std headers
+#include <stdexcept>
+
+namespace vke {
+
+VkePipelineLayoutCache::~VkePipelineLayoutCache() {
+  for (auto &kv : pipelineLayouts) {
+    vkDestroyPipelineLayout(device, kv.second, nullptr);
+  }
+  for (auto &kv : setLayouts_) {
+    vkDestroyDescriptorSetLayout(device, kv.second, nullptr);
+  }
+}
+
+VkPipelineLayout VkePipelineLayoutCache::get(const VkePipelineLayoutDescription &description) {
+  std::vector<uint32_t> key = description.key();
+
+  std::lock_guard<std::mutex> lock{mutex};
+  auto it = pipelineLayouts.find(key);
+  if (it != pipelineLayouts.end()) {
+    return it->second;
+  }
+
+  std::vector<VkDescriptorSetLayout> sets;
+  sets.reserve(description.sets.size());
+  for (const auto &bindings : description.sets) {
+    sets.push_back(getSetLayout(bindings));
+  }
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(sets.size());
+  pipelineLayoutInfo.pSetLayouts = sets.empty() ? nullptr : sets.data();
+  pipelineLayoutInfo.pushConstantRangeCount =
+      static_cast<uint32_t>(description.pushConstantRanges.size());
+  pipelineLayoutInfo.pPushConstantRanges =
+      description.pushConstantRanges.empty() ? nullptr : description.pushConstantRanges.data();
+
+  VkPipelineLayout layout;
+  if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &layout) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create pipeline layout!");
+  }
+  pipelineLayouts.emplace(std::move(key), layout);
+  return layout;
+}
+
+std::vector<VkDescriptorSetLayout> VkePipelineLayoutCache::setLayouts(
+    const VkePipelineLayoutDescription &description) {
+  std::lock_guard<std::mutex> lock{mutex};
+  std::vector<VkDescriptorSetLayout> sets;
+  for (const auto &bindings : description.sets) {
+    sets.push_back(getSetLayout(bindings));
+  }
+  return sets;
+}
+
+size_t VkePipelineLayoutCache::pipelineLayoutCount() {
+  std::lock_guard<std::mutex> lock{mutex};
+  return pipelineLayouts.size();
+}
+
+VkDescriptorSetLayout VkePipelineLayoutCache::getSetLayout(
+    const std::vector<VkDescriptorSetLayoutBinding> &bindings) {
+  std::vector<uint32_t> key = VkePipelineLayoutDescription::setKey(bindings);
+  auto it = setLayouts_.find(key);
+  if (it != setLayouts_.end()) {
+    return it->second;
+  }
+
+  VkDescriptorSetLayoutCreateInfo layoutInfo{};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+  layoutInfo.pBindings = bindings.empty() ? nullptr : bindings.data();
+
+  VkDescriptorSetLayout setLayout;
+  if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &setLayout) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create descriptor set layout!");
+  }
+  setLayouts_.emplace(std::move(key), setLayout);
+  return setLayout;
+}
+
+}  // namespace vke
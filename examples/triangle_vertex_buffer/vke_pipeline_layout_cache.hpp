@@ -0,0 +1,44 @@
+#pragma once
+
+#include "vke_spirv_reflect.hpp"
+
+// vulkan headers
+#include <vulkan/vulkan.h>
+
+// std lib headers
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace vke {
+
+// Device level cache of VkDescriptorSetLayouts and VkPipelineLayouts built from reflected shaders.
+// Equal descriptions give the same handle, so pipelines whose stages declare the same interface
+// share one layout (and stay compatible for descriptor binding). Everything lives as long as the
+// cache. Thread safe.
+class VkePipelineLayoutCache {
+ public:
+  explicit VkePipelineLayoutCache(VkDevice device) : device{device} {}
+  ~VkePipelineLayoutCache();
+
+  VkePipelineLayoutCache(const VkePipelineLayoutCache &) = delete;
+  VkePipelineLayoutCache &operator=(const VkePipelineLayoutCache &) = delete;
+
+  VkPipelineLayout get(const VkePipelineLayoutDescription &description);
+  // set layouts of a layout returned by get, index = set number
+  std::vector<VkDescriptorSetLayout> setLayouts(const VkePipelineLayoutDescription &description);
+
+  size_t pipelineLayoutCount();
+
+ private:
+  VkDescriptorSetLayout getSetLayout(const std::vector<VkDescriptorSetLayoutBinding> &bindings);
+
+  VkDevice device;
+  std::map<std::vector<uint32_t>, VkDescriptorSetLayout> setLayouts_;
+  std::map<std::vector<uint32_t>, VkPipelineLayout> pipelineLayouts;
+  std::mutex mutex;
+};
+
+}  // namespace vke
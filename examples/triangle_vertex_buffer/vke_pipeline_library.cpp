@@ -0,0 +1,301 @@
+#include "vke_pipeline_library.hpp"
+
+// std headers
+#include <cassert>
+#include <stdexcept>
+#include <utility>
+
+namespace vke {
+
+namespace {
+
+void appendHash(std::vector<uint32_t> &words, uint64_t hash) {
+  words.push_back(static_cast<uint32_t>(hash));
+  words.push_back(static_cast<uint32_t>(hash >> 32));
+}
+
+}  // namespace
+
+VkePipelineLibrary::VkePipelineLibrary(VkDerkDevice &device) : device{device} {
+#ifdef VK_EXT_graphics_pipeline_library
+  useLibraries = device.graphicsPipelineLibrarySupported();
+#endif
+}
+
+VkePipelineLibrary::~VkePipelineLibrary() {
+  for (auto &kv : libraries) {
+    vkDestroyPipeline(device.device(), kv.second.pipeline, nullptr);
+  }
+  for (auto &kv : basePipelines) {
+    vkDestroyPipeline(device.device(), kv.second.pipeline, nullptr);
+  }
+}
+
+bool VkePipelineLibrary::Cached::expired() const {
+  for (const auto &shader : shaders) {
+    if (shader.expired()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// A dead module can only come back with the same SPIR-V, which is rare enough to recompile. Bases
+// are safe to destroy too: a variant using one as its handle holds the modules, so it's gone as well
+void VkePipelineLibrary::evictExpired() {
+  std::lock_guard<std::mutex> lock{mutex};
+  for (auto *cache : {&libraries, &basePipelines}) {
+    for (auto it = cache->begin(); it != cache->end();) {
+      if (it->second.expired()) {
+        vkDestroyPipeline(device.device(), it->second.pipeline, nullptr);
+        it = cache->erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+}
+
+std::unique_ptr<VkePipeline> VkePipelineLibrary::create(
+    VkeShaderRegistry::Handle vertShader,
+    VkeShaderRegistry::Handle fragShader,
+    const PipelineConfigInfo &configInfo) {
+  evictExpired();
+
+  // create state points into itself, keep it where it is
+  auto state = std::make_unique<GraphicsPipelineCreateState>();
+  state->config = configInfo;
+  VkePipeline::populateCreateState(*state, *vertShader, *fragShader);
+
+  bool ownsPipeline = true;
+  VkPipeline pipeline = useLibraries ? link(*state, vertShader, fragShader)
+                                     : derive(*state, vertShader, fragShader, ownsPipeline);
+  return std::make_unique<VkePipeline>(
+      device, std::move(vertShader), std::move(fragShader), pipeline, ownsPipeline);
+}
+
+size_t VkePipelineLibrary::libraryCount() {
+  std::lock_guard<std::mutex> lock{mutex};
+  return libraries.size();
+}
+
+size_t VkePipelineLibrary::basePipelineCount() {
+  std::lock_guard<std::mutex> lock{mutex};
+  return basePipelines.size();
+}
+
+std::vector<uint32_t> VkePipelineLibrary::partKey(
+    Part part, const PipelineConfigInfo &configInfo, uint64_t shaderHash) {
+  // copy only what the part is built from, everything else stays zero and keys the same for all
+  PipelineConfigInfo slice{};
+  slice.dynamicStateEnables = configInfo.dynamicStateEnables;
+  switch (part) {
+    case VERTEX_INPUT:
+      slice.inputAssemblyInfo = configInfo.inputAssemblyInfo;
+      slice.bindingDescriptions = configInfo.bindingDescriptions;
+      slice.attributeDescriptions = configInfo.attributeDescriptions;
+      break;
+    case PRE_RASTERIZATION:
+      slice.rasterizationInfo = configInfo.rasterizationInfo;
+      slice.vertSpecialization = configInfo.vertSpecialization;
+      slice.pipelineLayout = configInfo.pipelineLayout;
+      break;
+    case FRAGMENT_SHADER:
+      slice.depthStencilInfo = configInfo.depthStencilInfo;
+      slice.multisampleInfo = configInfo.multisampleInfo;
+      slice.fragSpecialization = configInfo.fragSpecialization;
+      slice.pipelineLayout = configInfo.pipelineLayout;
+      break;
+    case FRAGMENT_OUTPUT:
+    default:
+      slice.colorBlendAttachment = configInfo.colorBlendAttachment;
+      slice.colorBlendInfo = configInfo.colorBlendInfo;
+      slice.multisampleInfo = configInfo.multisampleInfo;
+      break;
+  }
+  if (part != VERTEX_INPUT) {
+    slice.renderPass = configInfo.renderPass;
+    slice.subpass = configInfo.subpass;
+  }
+
+  std::vector<uint32_t> words = PipelineConfigKey::from(slice).words;
+  words.push_back(part);
+  appendHash(words, shaderHash);
+  return words;
+}
+
+VkPipeline VkePipelineLibrary::link(
+    GraphicsPipelineCreateState &state,
+    const VkeShaderRegistry::Handle &vertShader,
+    const VkeShaderRegistry::Handle &fragShader) {
+#ifdef VK_EXT_graphics_pipeline_library
+  VkPipeline parts[PART_COUNT] = {
+      getPart(VERTEX_INPUT, state, nullptr),
+      getPart(PRE_RASTERIZATION, state, vertShader),
+      getPart(FRAGMENT_SHADER, state, fragShader),
+      getPart(FRAGMENT_OUTPUT, state, nullptr),
+  };
+
+  VkPipelineLibraryCreateInfoKHR linkInfo{};
+  linkInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR;
+  linkInfo.libraryCount = PART_COUNT;
+  linkInfo.pLibraries = parts;
+
+  // no VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT: the fast link is the point
+  VkGraphicsPipelineCreateInfo pipelineInfo{};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+  pipelineInfo.pNext = &linkInfo;
+  pipelineInfo.layout = state.config.pipelineLayout;
+  pipelineInfo.basePipelineIndex = -1;
+
+  VkPipeline pipeline;
+  if (vkCreateGraphicsPipelines(
+          device.device(), device.pipelineCache().handle(), 1, &pipelineInfo, nullptr, &pipeline) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to link graphics pipeline!");
+  }
+  return pipeline;
+#else
+  bool ownsPipeline = true;
+  VkPipeline pipeline = derive(state, vertShader, fragShader, ownsPipeline);
+  assert(ownsPipeline && "headers without the extension never take the library path");
+  return pipeline;
+#endif
+}
+
+VkPipeline VkePipelineLibrary::getPart(
+    Part part, const GraphicsPipelineCreateState &state, const VkeShaderRegistry::Handle &shader) {
+  std::vector<uint32_t> key = partKey(part, state.config, shader ? shader->hash() : 0);
+  {
+    std::lock_guard<std::mutex> lock{mutex};
+    auto it = libraries.find(key);
+    if (it != libraries.end()) {
+      return it->second.pipeline;
+    }
+  }
+
+  // compiled outside the lock so links of cached parts never wait on a compile. Two threads
+  // building the same part both compile it, the loser's copy is dropped
+  Cached library;
+  library.pipeline = createPart(part, state);
+  if (shader) {
+    library.shaders.push_back(shader);
+  }
+  std::lock_guard<std::mutex> lock{mutex};
+  auto inserted = libraries.emplace(std::move(key), library);
+  if (!inserted.second) {
+    vkDestroyPipeline(device.device(), library.pipeline, nullptr);
+  }
+  return inserted.first->second.pipeline;
+}
+
+VkPipeline VkePipelineLibrary::createPart(Part part, const GraphicsPipelineCreateState &state) {
+#ifdef VK_EXT_graphics_pipeline_library
+  const VkGraphicsPipelineCreateInfo &full = state.pipelineInfo;
+
+  VkGraphicsPipelineLibraryCreateInfoEXT libraryInfo{};
+  libraryInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT;
+
+  // each part gets only the state the spec assigns to it, dynamic states are shared by all
+  VkGraphicsPipelineCreateInfo pipelineInfo{};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+  pipelineInfo.pNext = &libraryInfo;
+  pipelineInfo.flags = VK_PIPELINE_CREATE_LIBRARY_BIT_KHR;
+  pipelineInfo.pDynamicState = full.pDynamicState;
+  pipelineInfo.basePipelineIndex = -1;
+  switch (part) {
+    case VERTEX_INPUT:
+      libraryInfo.flags = VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT;
+      pipelineInfo.pVertexInputState = full.pVertexInputState;
+      pipelineInfo.pInputAssemblyState = full.pInputAssemblyState;
+      break;
+    case PRE_RASTERIZATION:
+      libraryInfo.flags = VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT;
+      pipelineInfo.stageCount = 1;
+      pipelineInfo.pStages = &state.shaderStages[0];
+      pipelineInfo.pViewportState = full.pViewportState;
+      pipelineInfo.pRasterizationState = full.pRasterizationState;
+      pipelineInfo.layout = full.layout;
+      break;
+    case FRAGMENT_SHADER:
+      libraryInfo.flags = VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT;
+      pipelineInfo.stageCount = 1;
+      pipelineInfo.pStages = &state.shaderStages[1];
+      pipelineInfo.pDepthStencilState = full.pDepthStencilState;
+      pipelineInfo.pMultisampleState = full.pMultisampleState;
+      pipelineInfo.layout = full.layout;
+      break;
+    case FRAGMENT_OUTPUT:
+    default:
+      libraryInfo.flags = VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT;
+      pipelineInfo.pColorBlendState = full.pColorBlendState;
+      pipelineInfo.pMultisampleState = full.pMultisampleState;
+      break;
+  }
+  if (part != VERTEX_INPUT) {
+    pipelineInfo.renderPass = full.renderPass;
+    pipelineInfo.subpass = full.subpass;
+  }
+
+  VkPipeline library;
+  if (vkCreateGraphicsPipelines(
+          device.device(), device.pipelineCache().handle(), 1, &pipelineInfo, nullptr, &library) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create graphics pipeline library!");
+  }
+  return library;
+#else
+  (void)part;
+  (void)state;
+  throw std::runtime_error("graphics pipeline libraries not supported by these headers");
+#endif
+}
+
+VkPipeline VkePipelineLibrary::derive(
+    GraphicsPipelineCreateState &state,
+    const VkeShaderRegistry::Handle &vertShader,
+    const VkeShaderRegistry::Handle &fragShader,
+    bool &ownsPipeline) {
+  std::vector<uint32_t> key;
+  appendHash(key, vertShader->hash());
+  appendHash(key, fragShader->hash());
+
+  VkPipeline base = VK_NULL_HANDLE;
+  {
+    std::lock_guard<std::mutex> lock{mutex};
+    auto it = basePipelines.find(key);
+    if (it != basePipelines.end()) {
+      base = it->second.pipeline;
+    }
+  }
+  VkDevice vkDevice = device.device();
+  VkPipelineCache cache = device.pipelineCache().handle();
+
+  if (base == VK_NULL_HANDLE) {
+    // the first state seen for this shader pair is the variant and the base of every later one
+    Cached created;
+    created.shaders = {vertShader, fragShader};
+    state.pipelineInfo.flags = VK_PIPELINE_CREATE_ALLOW_DERIVATIVES_BIT;
+    if (vkCreateGraphicsPipelines(
+            vkDevice, cache, 1, &state.pipelineInfo, nullptr, &created.pipeline) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create base graphics pipeline!");
+    }
+    std::lock_guard<std::mutex> lock{mutex};
+    // a thread that raced us to the same base keeps its own, ours is then an ordinary pipeline
+    ownsPipeline = !basePipelines.emplace(std::move(key), created).second;
+    return created.pipeline;
+  }
+
+  state.pipelineInfo.flags = VK_PIPELINE_CREATE_DERIVATIVE_BIT;
+  state.pipelineInfo.basePipelineHandle = base;
+  state.pipelineInfo.basePipelineIndex = -1;
+
+  VkPipeline pipeline;
+  if (vkCreateGraphicsPipelines(vkDevice, cache, 1, &state.pipelineInfo, nullptr, &pipeline) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create derivative graphics pipeline!");
+  }
+  return pipeline;
+}
+
+}  // namespace vke
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "vke_pipeline.hpp"
+
+// std lib headers
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace vke {
+
+// Fast pipeline variants (material tweaks, hot reloaded shaders) created on the calling thread.
+//
+// With VK_EXT_graphics_pipeline_library a pipeline is split into its four parts: vertex input,
+// pre-rasterization (vertex shader, rasterization), fragment shader (with depth/stencil) and
+// fragment output (blending). Each part is compiled once into a library, cached by the slice of
+// the config it depends on plus its shader's hash, and a variant is linked from four libraries
+// without link time optimization, which costs microseconds instead of a compile. Only the parts a
+// variant actually changes get compiled: a new blend mode compiles no shader at all. Hot variants
+// can be rebuilt in the background through VkePipelineBuilder for the fully optimized pipeline.
+//
+// Without the extension variants are derivatives (VK_PIPELINE_CREATE_DERIVATIVE_BIT) of a base
+// pipeline kept per shader pair, which drivers that honour it can build faster. The first variant
+// of a shader pair is that base itself (one compile, the returned VkePipeline doesn't own it).
+//
+// Thread safe. Parts and bases are dropped once a shader module they were built from is no longer
+// alive (a hot reload replaced it); linked pipelines and derivatives don't depend on them. Bases
+// returned as variants go with this object, so no variant may outlive it.
+class VkePipelineLibrary {
+ public:
+  explicit VkePipelineLibrary(VkDerkDevice &device);
+  ~VkePipelineLibrary();
+
+  VkePipelineLibrary(const VkePipelineLibrary &) = delete;
+  VkePipelineLibrary &operator=(const VkePipelineLibrary &) = delete;
+
+  // throws std::runtime_error if a part, the link or the derivative fails to build
+  std::unique_ptr<VkePipeline> create(
+      VkeShaderRegistry::Handle vertShader,
+      VkeShaderRegistry::Handle fragShader,
+      const PipelineConfigInfo &configInfo);
+
+  // false: the derivative fallback is in use
+  bool usesLibraries() const { return useLibraries; }
+
+  // part libraries / derivative bases held
+  size_t libraryCount();
+  size_t basePipelineCount();
+
+ private:
+  enum Part : uint32_t {
+    VERTEX_INPUT,
+    PRE_RASTERIZATION,
+    FRAGMENT_SHADER,
+    FRAGMENT_OUTPUT,
+    PART_COUNT
+  };
+
+  // a part or base, with the shader modules it was built from (none for shaderless parts)
+  struct Cached {
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    std::vector<std::weak_ptr<const VkeShaderModule>> shaders;
+
+    bool expired() const;
+  };
+
+  VkPipeline link(
+      GraphicsPipelineCreateState &state,
+      const VkeShaderRegistry::Handle &vertShader,
+      const VkeShaderRegistry::Handle &fragShader);
+  VkPipeline getPart(
+      Part part,
+      const GraphicsPipelineCreateState &state,
+      const VkeShaderRegistry::Handle &shader);
+  VkPipeline createPart(Part part, const GraphicsPipelineCreateState &state);
+  // ownsPipeline false: the base itself was returned
+  VkPipeline derive(
+      GraphicsPipelineCreateState &state,
+      const VkeShaderRegistry::Handle &vertShader,
+      const VkeShaderRegistry::Handle &fragShader,
+      bool &ownsPipeline);
+  void evictExpired();
+
+  // the fields of configInfo a part is compiled from, as key words
+  static std::vector<uint32_t> partKey(
+      Part part, const PipelineConfigInfo &configInfo, uint64_t shaderHash);
+
+  VkDerkDevice &device;
+  bool useLibraries = false;
+
+  std::map<std::vector<uint32_t>, Cached> libraries;
+  std::map<std::vector<uint32_t>, Cached> basePipelines;
+  std::mutex mutex;
+};
+
+}  // namespace vke
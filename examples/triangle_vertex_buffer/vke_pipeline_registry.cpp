@@ -0,0 +1,56 @@
+#include "vke_pipeline_registry.hpp"
+
+// std headers
+#include <utility>
+
+namespace vke {
+
+VkePipelineRegistry::VkePipelineRegistry(VkDerkDevice &device, VkePipelineBuilder &builder)
+    : device{device}, builder{builder} {}
+
+VkePipelineRegistry::Pending VkePipelineRegistry::request(
+    const std::string &vertFilepath,
+    const std::string &fragFilepath,
+    const PipelineConfigInfo &configInfo) {
+  // the key needs the module hashes; modules already loaded come straight out of the shader registry
+  return request(
+      device.shaderRegistry().load(vertFilepath),
+      device.shaderRegistry().load(fragFilepath),
+      configInfo);
+}
+
+VkePipelineRegistry::Pending VkePipelineRegistry::request(
+    VkeSpirvSpan vertCode, VkeSpirvSpan fragCode, const PipelineConfigInfo &configInfo) {
+  return request(
+      device.shaderRegistry().get(vertCode), device.shaderRegistry().get(fragCode), configInfo);
+}
+
+VkePipelineRegistry::Pending VkePipelineRegistry::request(
+    VkeShaderRegistry::Handle vertShader,
+    VkeShaderRegistry::Handle fragShader,
+    const PipelineConfigInfo &configInfo) {
+  Key key{PipelineConfigKey::from(configInfo), vertShader->hash(), fragShader->hash()};
+
+  std::lock_guard<std::mutex> lock{mutex};
+  auto it = pipelines.find(key);
+  if (it != pipelines.end()) {
+    hits++;
+    return it->second;
+  }
+
+  Pending pending = builder.submit(std::move(vertShader), std::move(fragShader), configInfo).share();
+  pipelines.emplace(std::move(key), pending);
+  return pending;
+}
+
+size_t VkePipelineRegistry::size() {
+  std::lock_guard<std::mutex> lock{mutex};
+  return pipelines.size();
+}
+
+uint64_t VkePipelineRegistry::hitCount() {
+  std::lock_guard<std::mutex> lock{mutex};
+  return hits;
+}
+
+}  // namespace vke
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "vke_pipeline.hpp"
+#include "vke_pipeline_builder.hpp"
+
+// std lib headers
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace vke {
+
+// Pipelines deduplicated by state: a request is keyed by the PipelineConfigKey of its config plus
+// the hashes of its two shader modules, and a repeated key gets the pipeline (or the in-flight
+// build) of the first request instead of a new compile. Materials sharing a state therefore share
+// one VkPipeline, and a bind can be skipped whenever the next draw's pipeline is the bound one.
+//
+// New states are compiled on the VkePipelineBuilder. The registry owns every pipeline it hands out
+// until it is destroyed; destroy it only once the GPU is done with them. Thread safe.
+class VkePipelineRegistry {
+ public:
+  using Pending = std::shared_future<std::unique_ptr<VkePipeline>>;
+
+  VkePipelineRegistry(VkDerkDevice &device, VkePipelineBuilder &builder);
+
+  VkePipelineRegistry(const VkePipelineRegistry &) = delete;
+  VkePipelineRegistry &operator=(const VkePipelineRegistry &) = delete;
+
+  // Non-blocking: the existing pipeline / build for this state, or a newly queued build
+  Pending request(
+      const std::string &vertFilepath,
+      const std::string &fragFilepath,
+      const PipelineConfigInfo &configInfo);
+  Pending request(VkeSpirvSpan vertCode, VkeSpirvSpan fragCode, const PipelineConfigInfo &configInfo);
+  Pending request(
+      VkeShaderRegistry::Handle vertShader,
+      VkeShaderRegistry::Handle fragShader,
+      const PipelineConfigInfo &configInfo);
+
+  // Blocking versions, rethrow if the build failed
+  VkePipeline &get(
+      const std::string &vertFilepath,
+      const std::string &fragFilepath,
+      const PipelineConfigInfo &configInfo) {
+    return *request(vertFilepath, fragFilepath, configInfo).get();
+  }
+  VkePipeline &get(VkeSpirvSpan vertCode, VkeSpirvSpan fragCode, const PipelineConfigInfo &configInfo) {
+    return *request(vertCode, fragCode, configInfo).get();
+  }
+
+  // distinct states held
+  size_t size();
+  // requests answered with an existing pipeline or build
+  uint64_t hitCount();
+
+ private:
+  struct Key {
+    PipelineConfigKey config;
+    uint64_t vertHash;
+    uint64_t fragHash;
+
+    bool operator==(const Key &other) const {
+      return vertHash == other.vertHash && fragHash == other.fragHash && config == other.config;
+    }
+  };
+  struct KeyHash {
+    size_t operator()(const Key &key) const {
+      uint64_t hash = key.config.hash;
+      hash = (hash ^ key.vertHash) * 1099511628211ull;
+      hash = (hash ^ key.fragHash) * 1099511628211ull;
+      return static_cast<size_t>(hash);
+    }
+  };
+
+  VkDerkDevice &device;
+  VkePipelineBuilder &builder;
+
+  std::unordered_map<Key, Pending, KeyHash> pipelines;
+  uint64_t hits = 0;
+  std::mutex mutex;
+};
+
+}  // namespace vke
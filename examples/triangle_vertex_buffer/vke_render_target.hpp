@@ -0,0 +1,41 @@
+#pragma once
+
+#include "vke_timeline.hpp"
+
+// vulkan headers
+#include <vulkan/vulkan.h>
+
+// std lib headers
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace vke {
+
+// What a frame renders into and how it gets there: VkeSwapChain for a window, VkeOffscreenRing
+// headless. The app records against the render pass / framebuffer of the acquired image and
+// submits through the target, so one draw path serves both.
+class VkeRenderTarget {
+ public:
+  // capacity: per-frame objects (and the app's per-frame resources) exist this many times,
+  // the target decides how many of them are in use
+  static constexpr int MAX_FRAMES_IN_FLIGHT = 3;
+
+  virtual ~VkeRenderTarget() = default;
+
+  virtual VkRenderPass getRenderPass() = 0;
+  virtual VkFramebuffer getFrameBuffer(int index) = 0;
+  virtual VkExtent2D getExtent() = 0;
+  // frame-in-flight slot, valid after acquireNextImage
+  virtual size_t getCurrentFrame() = 0;
+
+  // waits until the current slot's previous frame has completed, then picks the image to render to
+  virtual VkResult acquireNextImage(uint32_t *imageIndex) = 0;
+  // submits on the graphics timeline after extraWaits, and presents if there is anything to present
+  virtual VkResult submitCommandBuffers(
+      const VkCommandBuffer *buffers,
+      uint32_t *imageIndex,
+      const std::vector<VkeSemaphoreWait> &extraWaits = {}) = 0;
+};
+
+}  // namespace vke
@@ -0,0 +1,135 @@
+#include "vke_shader_registry.hpp"
+
+// std headers
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace vke {
+
+uint64_t VkeShaderRegistry::hashCode(const void *data, size_t size) {
+  const auto *bytes = static_cast<const unsigned char *>(data);
+  uint64_t hash = 14695981039346656037ull;
+  for (size_t i = 0; i < size; i++) {
+    hash = (hash ^ bytes[i]) * 1099511628211ull;
+  }
+  return hash;
+}
+
+std::vector<char> VkeShaderRegistry::readFile(const std::string &filepath) {
+  std::ifstream file{filepath, std::ios::ate | std::ios::binary};
+
+  if (!file.is_open()) {
+    throw std::runtime_error("failed to open file: " + filepath);
+  }
+
+  size_t fileSize = static_cast<size_t>(file.tellg());
+  std::vector<char> buffer(fileSize);
+
+  file.seekg(0);
+  file.read(buffer.data(), fileSize);
+  return buffer;
+}
+
+VkeShaderRegistry::Handle VkeShaderRegistry::load(const std::string &filepath) {
+  {
+    std::lock_guard<std::mutex> lock{mutex};
+    auto it = pathHashes.find(filepath);
+    if (it != pathHashes.end()) {
+      if (Handle module = findLive(it->second)) {
+        return module;
+      }
+    }
+  }
+
+  // read outside the lock, two threads loading the same file just race to the same module
+  std::vector<char> code = readFile(filepath);
+  if (code.empty() || code.size() % sizeof(uint32_t) != 0) {
+    throw std::runtime_error("not a SPIR-V binary: " + filepath);
+  }
+  std::vector<uint32_t> words(code.size() / sizeof(uint32_t));
+  memcpy(words.data(), code.data(), code.size());
+
+  uint64_t hash = hashCode(words.data(), code.size());
+  std::lock_guard<std::mutex> lock{mutex};
+  Handle module = findOrCreate(hash, words.data(), code.size());
+  pathHashes[filepath] = module->hash();
+  return module;
+}
+
+VkeShaderRegistry::Handle VkeShaderRegistry::reload(const std::string &filepath) {
+  {
+    std::lock_guard<std::mutex> lock{mutex};
+    pathHashes.erase(filepath);
+  }
+  return load(filepath);
+}
+
+VkeShaderRegistry::Handle VkeShaderRegistry::get(VkeSpirvSpan code) {
+  assert(code.size > 0 && "empty SPIR-V");
+  uint64_t hash = hashCode(code.data, code.sizeBytes());
+  std::lock_guard<std::mutex> lock{mutex};
+  return findOrCreate(hash, code.data, code.sizeBytes());
+}
+
+VkeShaderRegistry::Handle VkeShaderRegistry::findLive(uint64_t hash) {
+  auto it = modules.find(hash);
+  if (it == modules.end()) {
+    return nullptr;
+  }
+  Handle module = it->second.lock();
+  if (!module) {
+    modules.erase(it);
+  }
+  return module;
+}
+
+VkeShaderRegistry::Handle VkeShaderRegistry::findOrCreate(
+    uint64_t hash, const uint32_t *code, size_t codeSize) {
+  // a live module under the hash with other words is a collision: probe the next key, so hash()
+  // stays a unique id for the pipeline registry & library keys
+  Handle module;
+  while ((module = findLive(hash)) != nullptr) {
+    if (module->sameCode(code, codeSize)) {
+      return module;
+    }
+    hash++;
+  }
+
+  // reflect first: a binary we can't parse never becomes a module
+  VkeShaderReflection reflection =
+      VkeShaderReflection::reflect(code, codeSize / sizeof(uint32_t));
+
+  VkShaderModuleCreateInfo createInfo{};
+  createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+  createInfo.codeSize = codeSize;
+  createInfo.pCode = code;
+
+  VkShaderModule shaderModule;
+  if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create shader module");
+  }
+
+  module = std::make_shared<const VkeShaderModule>(
+      device,
+      shaderModule,
+      hash,
+      std::vector<uint32_t>(code, code + codeSize / sizeof(uint32_t)),
+      std::move(reflection));
+  modules[hash] = module;
+  return module;
+}
+
+size_t VkeShaderRegistry::size() {
+  std::lock_guard<std::mutex> lock{mutex};
+  size_t live = 0;
+  for (auto &kv : modules) {
+    if (!kv.second.expired()) {
+      live++;
+    }
+  }
+  return live;
+}
+
+}  // namespace vke
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "vke_spirv_reflect.hpp"
+
+// vulkan headers
+#include <vulkan/vulkan.h>
+
+// std lib headers
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace vke {
+
+// Non-owning view of SPIR-V words, a std::span<const uint32_t> stand-in while we're on C++17.
+// Built implicitly from the constexpr arrays embed_spirv.cmake generates or from a word vector.
+struct VkeSpirvSpan {
+  const uint32_t *data = nullptr;
+  size_t size = 0;  // in words
+
+  constexpr VkeSpirvSpan() = default;
+  constexpr VkeSpirvSpan(const uint32_t *data, size_t size) : data{data}, size{size} {}
+  template <size_t N>
+  constexpr VkeSpirvSpan(const uint32_t (&words)[N]) : data{words}, size{N} {}
+  VkeSpirvSpan(const std::vector<uint32_t> &words) : data{words.data()}, size{words.size()} {}
+
+  size_t sizeBytes() const { return size * sizeof(uint32_t); }
+};
+
+// A compiled VkShaderModule, destroyed when the last pipeline holding it lets go. Carries the
+// reflection of its SPIR-V, parsed once when the module is created, and the words themselves so a
+// hash hit can be told apart from a collision.
+class VkeShaderModule {
+ public:
+  VkeShaderModule(
+      VkDevice device,
+      VkShaderModule module,
+      uint64_t hash,
+      std::vector<uint32_t> code,
+      VkeShaderReflection reflection)
+      : device{device},
+        module{module},
+        hash_{hash},
+        code_{std::move(code)},
+        reflection_{std::move(reflection)} {}
+  ~VkeShaderModule() { vkDestroyShaderModule(device, module, nullptr); }
+
+  VkeShaderModule(const VkeShaderModule &) = delete;
+  VkeShaderModule &operator=(const VkeShaderModule &) = delete;
+
+  VkShaderModule handle() const { return module; }
+  // unique among live modules: the content hash, bumped past any colliding module
+  uint64_t hash() const { return hash_; }
+  size_t codeSize() const { return code_.size() * sizeof(uint32_t); }
+  bool sameCode(const uint32_t *code, size_t codeSize) const {
+    return codeSize == this->codeSize() && memcmp(code, code_.data(), codeSize) == 0;
+  }
+  const VkeShaderReflection &reflection() const { return reflection_; }
+
+ private:
+  VkDevice device;
+  VkShaderModule module;
+  uint64_t hash_;
+  std::vector<uint32_t> code_;
+  VkeShaderReflection reflection_;
+};
+
+// Device level shader module registry keyed by a FNV-1a hash of the SPIR-V bytes, so any number of
+// pipelines using the same shader share one VkShaderModule. Hits are confirmed by comparing the words. Handles are reference counted; the
+// registry only keeps weak references, an unused module is destroyed right away. Paths are memoized
+// to their hash, a file is only read again once nobody holds its module anymore. Thread safe.
+class VkeShaderRegistry {
+ public:
+  using Handle = std::shared_ptr<const VkeShaderModule>;
+
+  explicit VkeShaderRegistry(VkDevice device) : device{device} {}
+
+  VkeShaderRegistry(const VkeShaderRegistry &) = delete;
+  VkeShaderRegistry &operator=(const VkeShaderRegistry &) = delete;
+
+  // SPIR-V from a file
+  Handle load(const std::string &filepath);
+  // Reads the file again even if a module for it is alive (hot reload). Pipelines holding the old
+  // module keep it until they go away; unchanged contents give back the same module.
+  Handle reload(const std::string &filepath);
+  // SPIR-V already in memory, e.g. embedded at build time
+  Handle get(VkeSpirvSpan code);
+
+  static uint64_t hashCode(const void *data, size_t size);
+  static std::vector<char> readFile(const std::string &filepath);
+
+  // number of live modules
+  size_t size();
+
+ private:
+  Handle findOrCreate(uint64_t hash, const uint32_t *code, size_t codeSize);
+  Handle findLive(uint64_t hash);
+
+  VkDevice device;
+  std::unordered_map<uint64_t, std::weak_ptr<const VkeShaderModule>> modules;
+  std::unordered_map<std::string, uint64_t> pathHashes;
+  std::mutex mutex;
+};
+
+}  // namespace vke
@@ -0,0 +1,173 @@
+#include "vke_shader_watcher.hpp"
+
+// std headers
+#include <cstdio>
+#include <iostream>
+#include <system_error>
+#include <utility>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#endif
+
+namespace vke {
+
+namespace fs = std::filesystem;
+
+VkeShaderWatcher::VkeShaderWatcher(
+    std::string sourceDir, std::string outputDir, std::string compilerCommand)
+    : sourceDir{std::move(sourceDir)},
+      outputDir{std::move(outputDir)},
+      compilerCommand{std::move(compilerCommand)} {
+  thread = std::thread{[this] { run(); }};
+}
+
+VkeShaderWatcher::~VkeShaderWatcher() {
+  stopping = true;
+  thread.join();
+}
+
+std::vector<std::string> VkeShaderWatcher::takeRebuilt() {
+  std::lock_guard<std::mutex> lock{mutex};
+  std::vector<std::string> result;
+  result.swap(rebuilt);
+  return result;
+}
+
+bool VkeShaderWatcher::isShaderSource(const fs::path &path) {
+  fs::path extension = path.extension();
+  return extension == ".vert" || extension == ".frag" || extension == ".comp";
+}
+
+std::string VkeShaderWatcher::outputPath(const fs::path &source) const {
+  return (fs::path{outputDir} / source.filename()).string() + ".spv";
+}
+
+void VkeShaderWatcher::run() {
+#ifdef __linux__
+  int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (fd >= 0) {
+    // IN_MOVED_TO: editors that save to a temp file and rename it over the original
+    if (inotify_add_watch(fd, sourceDir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) >= 0) {
+      runInotify(fd);
+      close(fd);
+      return;
+    }
+    close(fd);
+  }
+  std::cout << "shader hot reload: inotify unavailable for " << sourceDir << ", polling"
+            << std::endl;
+#endif
+  runPolling();
+}
+
+#ifdef __linux__
+void VkeShaderWatcher::runInotify(int fd) {
+  std::map<std::string, std::chrono::steady_clock::time_point> changed;
+  alignas(inotify_event) char buffer[4096];
+
+  while (!stopping) {
+    pollfd pfd{fd, POLLIN, 0};
+    int timeoutMs = changed.empty() ? 100 : static_cast<int>(SETTLE_TIME.count());
+    if (poll(&pfd, 1, timeoutMs) > 0) {
+      ssize_t length;
+      while ((length = read(fd, buffer, sizeof(buffer))) > 0) {
+        for (char *p = buffer; p < buffer + length;) {
+          auto *event = reinterpret_cast<inotify_event *>(p);
+          if (event->len > 0) {
+            fs::path path = fs::path{sourceDir} / event->name;
+            if (isShaderSource(path)) {
+              changed[path.string()] = std::chrono::steady_clock::now();
+            }
+          }
+          p += sizeof(inotify_event) + event->len;
+        }
+      }
+    }
+    compileSettled(changed);
+  }
+}
+#endif
+
+void VkeShaderWatcher::runPolling() {
+  std::map<std::string, fs::file_time_type> lastWrite;
+  auto scan = [&](bool report) {
+    std::error_code error;
+    for (const auto &entry : fs::directory_iterator{sourceDir, error}) {
+      if (!entry.is_regular_file(error) || !isShaderSource(entry.path())) {
+        continue;
+      }
+      fs::file_time_type time = entry.last_write_time(error);
+      if (error) {
+        continue;
+      }
+      auto it = lastWrite.find(entry.path().string());
+      if (it == lastWrite.end() || it->second != time) {
+        lastWrite[entry.path().string()] = time;
+        if (report) {
+          compile(entry.path());  // edited or new
+        }
+      }
+    }
+  };
+
+  scan(false);  // baseline, only edits after startup trigger a compile
+  while (!stopping) {
+    // sleep in small steps so the destructor doesn't wait a whole interval
+    for (auto slept = std::chrono::milliseconds{0}; slept < POLL_INTERVAL && !stopping;
+         slept += std::chrono::milliseconds{25}) {
+      std::this_thread::sleep_for(std::chrono::milliseconds{25});
+    }
+    if (!stopping) {
+      scan(true);
+    }
+  }
+}
+
+void VkeShaderWatcher::compileSettled(
+    std::map<std::string, std::chrono::steady_clock::time_point> &changed) {
+  auto now = std::chrono::steady_clock::now();
+  for (auto it = changed.begin(); it != changed.end();) {
+    if (now - it->second >= SETTLE_TIME) {
+      compile(it->first);
+      it = changed.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void VkeShaderWatcher::compile(const fs::path &source) {
+  std::string output = outputPath(source);
+  std::string command =
+      compilerCommand + " \"" + source.string() + "\" -o \"" + output + "\" 2>&1";
+
+  FILE *pipe = popen(command.c_str(), "r");
+  if (pipe == nullptr) {
+    std::cerr << "shader hot reload: failed to run " << compilerCommand << std::endl;
+    return;
+  }
+  std::string log;
+  char chunk[256];
+  while (fgets(chunk, sizeof(chunk), pipe) != nullptr) {
+    log += chunk;
+  }
+  if (pclose(pipe) != 0) {
+    std::cerr << "shader hot reload: " << source.filename().string() << " failed to compile\n"
+              << log << std::flush;
+    return;
+  }
+
+  std::cout << "shader hot reload: rebuilt " << output << std::endl;
+  std::lock_guard<std::mutex> lock{mutex};
+  rebuilt.push_back(output);
+}
+
+}  // namespace vke
@@ -0,0 +1,60 @@
+#pragma once
+
+// std lib headers
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace vke {
+
+// Watches a directory of GLSL sources (.vert/.frag/.comp) and recompiles a file into
+// <outputDir>/<name>.spv (compile.bat naming) whenever it changes, all on a background thread.
+// Uses inotify on Linux and polls modification times elsewhere. Rebuilt binaries are collected
+// until the render loop asks for them with takeRebuilt(), which never blocks.
+//
+// compilerCommand is run through the shell as `<compilerCommand> "<source>" -o "<output>"`, so both
+// "glslc" and "glslangValidator -V" work. A failed compile prints the compiler output and reports
+// nothing, the previous .spv stays in place.
+class VkeShaderWatcher {
+ public:
+  static constexpr std::chrono::milliseconds POLL_INTERVAL{250};
+  // editors save in several writes, wait until a file has been quiet this long
+  static constexpr std::chrono::milliseconds SETTLE_TIME{50};
+
+  VkeShaderWatcher(std::string sourceDir, std::string outputDir, std::string compilerCommand);
+  ~VkeShaderWatcher();
+
+  VkeShaderWatcher(const VkeShaderWatcher &) = delete;
+  VkeShaderWatcher &operator=(const VkeShaderWatcher &) = delete;
+
+  // .spv paths rebuilt successfully since the last call
+  std::vector<std::string> takeRebuilt();
+
+  static bool isShaderSource(const std::filesystem::path &path);
+  std::string outputPath(const std::filesystem::path &source) const;
+
+ private:
+  void run();
+#ifdef __linux__
+  void runInotify(int fd);
+#endif
+  void runPolling();
+  void compile(const std::filesystem::path &source);
+  void compileSettled(std::map<std::string, std::chrono::steady_clock::time_point> &changed);
+
+  std::string sourceDir;
+  std::string outputDir;
+  std::string compilerCommand;
+
+  std::atomic<bool> stopping{false};
+  std::mutex mutex;
+  std::vector<std::string> rebuilt;
+  std::thread thread;
+};
+
+}  // namespace vke
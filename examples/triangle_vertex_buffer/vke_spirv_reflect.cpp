@@ -0,0 +1,671 @@
+#include "vke_spirv_reflect.hpp"
+
+// std headers
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace vke {
+
+namespace {
+
+// The handful of SPIR-V enumerants reflection needs (SPIR-V spec, section 3)
+constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+constexpr uint32_t SPIRV_HEADER_WORDS = 5;
+
+enum Op : uint32_t {
+  OpName = 5,
+  OpEntryPoint = 15,
+  OpExecutionMode = 16,
+  OpTypeBool = 20,
+  OpTypeInt = 21,
+  OpTypeFloat = 22,
+  OpTypeVector = 23,
+  OpTypeMatrix = 24,
+  OpTypeImage = 25,
+  OpTypeSampler = 26,
+  OpTypeSampledImage = 27,
+  OpTypeArray = 28,
+  OpTypeRuntimeArray = 29,
+  OpTypeStruct = 30,
+  OpTypePointer = 32,
+  OpConstant = 43,
+  OpConstantComposite = 44,
+  OpSpecConstant = 50,
+  OpSpecConstantComposite = 51,
+  OpVariable = 59,
+  OpDecorate = 71,
+  OpMemberDecorate = 72,
+  OpExecutionModeId = 331,
+};
+
+enum ExecutionMode : uint32_t {
+  ExecutionModeLocalSize = 17,
+  ExecutionModeLocalSizeId = 38,
+};
+
+constexpr uint32_t BUILT_IN_WORKGROUP_SIZE = 25;
+
+enum Decoration : uint32_t {
+  DecorationSpecId = 1,
+  DecorationBlock = 2,
+  DecorationBufferBlock = 3,
+  DecorationArrayStride = 6,
+  DecorationMatrixStride = 7,
+  DecorationBuiltIn = 11,
+  DecorationLocation = 30,
+  DecorationBinding = 33,
+  DecorationDescriptorSet = 34,
+  DecorationOffset = 35,
+};
+
+enum StorageClass : uint32_t {
+  StorageClassUniformConstant = 0,
+  StorageClassInput = 1,
+  StorageClassUniform = 2,
+  StorageClassPushConstant = 9,
+  StorageClassStorageBuffer = 12,
+};
+
+constexpr uint32_t DIM_BUFFER = 5;
+constexpr uint32_t DIM_SUBPASS_DATA = 6;
+
+struct Decorations {
+  uint32_t location = UINT32_MAX;
+  uint32_t binding = UINT32_MAX;
+  uint32_t set = UINT32_MAX;
+  uint32_t arrayStride = 0;
+  uint32_t specId = UINT32_MAX;
+  bool block = false;
+  bool bufferBlock = false;
+  bool builtIn = false;
+};
+
+struct MemberDecorations {
+  uint32_t offset = 0;
+  uint32_t matrixStride = 0;
+};
+
+struct Variable {
+  uint32_t pointerType;
+  uint32_t id;
+  uint32_t storageClass;
+};
+
+VkShaderStageFlagBits stageFromExecutionModel(uint32_t model) {
+  switch (model) {
+    case 0: return VK_SHADER_STAGE_VERTEX_BIT;
+    case 1: return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+    case 2: return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+    case 3: return VK_SHADER_STAGE_GEOMETRY_BIT;
+    case 4: return VK_SHADER_STAGE_FRAGMENT_BIT;
+    case 5: return VK_SHADER_STAGE_COMPUTE_BIT;
+    default: throw std::runtime_error("spirv reflect: unsupported execution model");
+  }
+}
+
+// Everything of interest in one pass over the module, then resolved on demand
+class Module {
+ public:
+  Module(const uint32_t *code, size_t wordCount) : code{code}, wordCount{wordCount} {
+    if (wordCount < SPIRV_HEADER_WORDS || code[0] != SPIRV_MAGIC) {
+      throw std::runtime_error("spirv reflect: not a SPIR-V binary");
+    }
+    parse();
+  }
+
+  bool hasEntryPoint = false;
+  uint32_t executionModel = 0;
+  // compute: LocalSize literals, or ids of the (spec) constants for LocalSizeId / a WorkgroupSize built-in
+  uint32_t localSize[3] = {1, 1, 1};
+  uint32_t localSizeIds[3] = {0, 0, 0};
+  bool localSizeFromIds = false;
+  uint32_t workgroupSizeId = 0;
+  std::vector<Variable> variables;
+
+  const std::vector<uint32_t> &type(uint32_t id) const {
+    auto it = types.find(id);
+    if (it == types.end()) {
+      throw std::runtime_error("spirv reflect: unknown type id " + std::to_string(id));
+    }
+    return it->second;
+  }
+
+  Decorations decorations(uint32_t id) const {
+    auto it = decorationsById.find(id);
+    return it == decorationsById.end() ? Decorations{} : it->second;
+  }
+
+  MemberDecorations memberDecorations(uint32_t structId, uint32_t member) const {
+    auto it = memberDecorationsById.find(structId);
+    if (it == memberDecorationsById.end() || member >= it->second.size()) {
+      return {};
+    }
+    return it->second[member];
+  }
+
+  bool hasBuiltInMember(uint32_t structId) const {
+    return builtInStructs.count(structId) != 0;
+  }
+
+  std::string name(uint32_t id) const {
+    auto it = names.find(id);
+    return it == names.end() ? std::string{} : it->second;
+  }
+
+  const std::vector<uint32_t> *composite(uint32_t id) const {
+    auto it = composites.find(id);
+    return it == composites.end() ? nullptr : &it->second;
+  }
+
+  uint32_t constant(uint32_t id) const {
+    auto it = constants.find(id);
+    if (it == constants.end()) {
+      throw std::runtime_error("spirv reflect: array length is not a constant");
+    }
+    return it->second;
+  }
+
+  // Byte size of a type inside an explicitly laid out block
+  uint32_t sizeOf(uint32_t typeId, uint32_t matrixStride = 0) const {
+    const auto &t = type(typeId);
+    switch (t[0] & 0xFFFF) {
+      case OpTypeBool: return 4;
+      case OpTypeInt:
+      case OpTypeFloat: return t[2] / 8;
+      case OpTypeVector: return t[3] * sizeOf(t[2]);
+      case OpTypeMatrix: return t[3] * (matrixStride != 0 ? matrixStride : sizeOf(t[2]));
+      case OpTypeArray: {
+        uint32_t stride = decorations(typeId).arrayStride;
+        return constant(t[3]) * (stride != 0 ? stride : sizeOf(t[2]));
+      }
+      case OpTypeRuntimeArray: return 0;
+      case OpTypeStruct: {
+        uint32_t size = 0;
+        for (uint32_t member = 0; member + 2 < t.size(); member++) {
+          MemberDecorations md = memberDecorations(typeId, member);
+          size = std::max(size, md.offset + sizeOf(t[member + 2], md.matrixStride));
+        }
+        return size;
+      }
+      default: return 0;
+    }
+  }
+
+ private:
+  void parse() {
+    size_t i = SPIRV_HEADER_WORDS;
+    while (i < wordCount) {
+      uint32_t opcode = code[i] & 0xFFFF;
+      uint32_t count = code[i] >> 16;
+      if (count == 0 || i + count > wordCount) {
+        throw std::runtime_error("spirv reflect: truncated instruction");
+      }
+      const uint32_t *ins = code + i;
+
+      switch (opcode) {
+        case OpName:
+          if (count > 2) {
+            names[ins[1]] = literalString(ins + 2, count - 2);
+          }
+          break;
+        case OpEntryPoint:
+          if (!hasEntryPoint) {  // first entry point wins, GLSL modules only have one
+            hasEntryPoint = true;
+            executionModel = ins[1];
+          }
+          break;
+        case OpExecutionMode:
+        case OpExecutionModeId:
+          if (count > 5 && ins[2] == ExecutionModeLocalSize) {
+            localSize[0] = ins[3];
+            localSize[1] = ins[4];
+            localSize[2] = ins[5];
+          } else if (count > 5 && ins[2] == ExecutionModeLocalSizeId) {
+            localSizeIds[0] = ins[3];
+            localSizeIds[1] = ins[4];
+            localSizeIds[2] = ins[5];
+            localSizeFromIds = true;
+          }
+          break;
+        case OpTypeBool:
+        case OpTypeInt:
+        case OpTypeFloat:
+        case OpTypeVector:
+        case OpTypeMatrix:
+        case OpTypeImage:
+        case OpTypeSampler:
+        case OpTypeSampledImage:
+        case OpTypeArray:
+        case OpTypeRuntimeArray:
+        case OpTypeStruct:
+        case OpTypePointer:
+          types[ins[1]].assign(ins, ins + count);
+          break;
+        case OpConstant:
+        case OpSpecConstant:  // spec constant array sizes resolve to their default
+          if (count > 3) {
+            constants[ins[2]] = ins[3];
+          }
+          break;
+        case OpConstantComposite:
+        case OpSpecConstantComposite:
+          composites[ins[2]].assign(ins + 3, ins + count);
+          break;
+        case OpVariable:
+          variables.push_back({ins[1], ins[2], ins[3]});
+          break;
+        case OpDecorate:
+          if (count > 2) {
+            decorate(decorationsById[ins[1]], ins[2], count > 3 ? ins[3] : 0);
+            if (ins[2] == DecorationBuiltIn && count > 3 && ins[3] == BUILT_IN_WORKGROUP_SIZE) {
+              workgroupSizeId = ins[1];
+            }
+          }
+          break;
+        case OpMemberDecorate:
+          if (count > 3) {
+            auto &members = memberDecorationsById[ins[1]];
+            if (members.size() <= ins[2]) {
+              members.resize(ins[2] + 1);
+            }
+            if (ins[3] == DecorationOffset && count > 4) {
+              members[ins[2]].offset = ins[4];
+            } else if (ins[3] == DecorationMatrixStride && count > 4) {
+              members[ins[2]].matrixStride = ins[4];
+            } else if (ins[3] == DecorationBuiltIn) {
+              builtInStructs.insert(ins[1]);
+            }
+          }
+          break;
+        default:
+          break;
+      }
+      i += count;
+    }
+  }
+
+  static void decorate(Decorations &d, uint32_t decoration, uint32_t operand) {
+    switch (decoration) {
+      case DecorationBlock: d.block = true; break;
+      case DecorationBufferBlock: d.bufferBlock = true; break;
+      case DecorationArrayStride: d.arrayStride = operand; break;
+      case DecorationBuiltIn: d.builtIn = true; break;
+      case DecorationSpecId: d.specId = operand; break;
+      case DecorationLocation: d.location = operand; break;
+      case DecorationBinding: d.binding = operand; break;
+      case DecorationDescriptorSet: d.set = operand; break;
+      default: break;
+    }
+  }
+
+  // nul terminated UTF-8, packed little endian into words
+  static std::string literalString(const uint32_t *words, size_t maxWords) {
+    std::string result;
+    for (size_t w = 0; w < maxWords; w++) {
+      for (int b = 0; b < 4; b++) {
+        char c = static_cast<char>((words[w] >> (8 * b)) & 0xFF);
+        if (c == '\0') {
+          return result;
+        }
+        result.push_back(c);
+      }
+    }
+    return result;
+  }
+
+  const uint32_t *code;
+  size_t wordCount;
+
+  std::unordered_map<uint32_t, std::vector<uint32_t>> types;  // full instruction
+  std::unordered_map<uint32_t, uint32_t> constants;
+  std::unordered_map<uint32_t, std::vector<uint32_t>> composites;  // constituent ids
+  std::unordered_map<uint32_t, std::string> names;
+  std::unordered_map<uint32_t, Decorations> decorationsById;
+  std::unordered_map<uint32_t, std::vector<MemberDecorations>> memberDecorationsById;
+  std::unordered_set<uint32_t> builtInStructs;
+};
+
+// Format of a scalar / vector shader input, UNDEFINED for what a vertex buffer can't feed
+VkFormat inputFormat(const Module &module, uint32_t typeId, uint32_t &size) {
+  const auto &t = module.type(typeId);
+  uint32_t components = 1;
+  const std::vector<uint32_t> *scalar = &t;
+  if ((t[0] & 0xFFFF) == OpTypeVector) {
+    components = t[3];
+    scalar = &module.type(t[2]);
+  }
+
+  uint32_t op = (*scalar)[0] & 0xFFFF;
+  if ((op != OpTypeFloat && op != OpTypeInt) || (*scalar)[2] != 32 || components > 4) {
+    size = 0;
+    return VK_FORMAT_UNDEFINED;
+  }
+  size = 4 * components;
+
+  static const VkFormat floats[] = {
+      VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT,
+      VK_FORMAT_R32G32B32A32_SFLOAT};
+  static const VkFormat sints[] = {
+      VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT,
+      VK_FORMAT_R32G32B32A32_SINT};
+  static const VkFormat uints[] = {
+      VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT,
+      VK_FORMAT_R32G32B32A32_UINT};
+  if (op == OpTypeFloat) {
+    return floats[components - 1];
+  }
+  return (*scalar)[3] != 0 ? sints[components - 1] : uints[components - 1];
+}
+
+VkDescriptorType descriptorType(
+    const Module &module, uint32_t storageClass, uint32_t typeId, bool &supported) {
+  supported = true;
+  const auto &t = module.type(typeId);
+  switch (storageClass) {
+    case StorageClassUniform:
+      return module.decorations(typeId).bufferBlock ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER
+                                                    : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    case StorageClassStorageBuffer:
+      return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    case StorageClassUniformConstant:
+      switch (t[0] & 0xFFFF) {
+        case OpTypeSampler: return VK_DESCRIPTOR_TYPE_SAMPLER;
+        case OpTypeSampledImage: return VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        case OpTypeImage: {
+          uint32_t dim = t[3];
+          uint32_t sampled = t[7];  // 1 = used with a sampler, 2 = storage image
+          if (dim == DIM_SUBPASS_DATA) {
+            return VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+          }
+          if (dim == DIM_BUFFER) {
+            return sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER
+                                : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+          }
+          return sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+        }
+        default: break;
+      }
+      break;
+    default:
+      break;
+  }
+  supported = false;  // e.g. acceleration structures, not used here
+  return VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+}
+
+// Workgroup size of a compute module. A WorkgroupSize built-in overrides the execution mode; sizes
+// coming from spec constants (local_size_x_id) resolve to their defaults and keep their SpecId
+void reflectLocalSize(const Module &module, uint32_t size[3], uint32_t specIds[3]) {
+  const uint32_t *ids = nullptr;
+  const std::vector<uint32_t> *workgroupSize =
+      module.workgroupSizeId != 0 ? module.composite(module.workgroupSizeId) : nullptr;
+  if (workgroupSize != nullptr && workgroupSize->size() == 3) {
+    ids = workgroupSize->data();
+  } else if (module.localSizeFromIds) {
+    ids = module.localSizeIds;
+  }
+
+  for (int i = 0; i < 3; i++) {
+    size[i] = ids != nullptr ? module.constant(ids[i]) : module.localSize[i];
+    specIds[i] = ids != nullptr ? module.decorations(ids[i]).specId : UINT32_MAX;
+  }
+}
+
+}  // namespace
+
+VkeShaderReflection VkeShaderReflection::reflect(const uint32_t *code, size_t wordCount) {
+  Module module{code, wordCount};
+  if (!module.hasEntryPoint) {
+    throw std::runtime_error("spirv reflect: module has no entry point");
+  }
+
+  VkeShaderReflection reflection{};
+  reflection.stage_ = stageFromExecutionModel(module.executionModel);
+
+  uint32_t pushBegin = UINT32_MAX;
+  uint32_t pushEnd = 0;
+
+  for (const Variable &variable : module.variables) {
+    const auto &pointer = module.type(variable.pointerType);
+    uint32_t typeId = pointer[3];
+    Decorations decorations = module.decorations(variable.id);
+
+    switch (variable.storageClass) {
+      case StorageClassInput: {
+        if (decorations.builtIn || decorations.location == UINT32_MAX ||
+            module.hasBuiltInMember(typeId)) {
+          break;
+        }
+        // matrices take one location per column
+        const auto &t = module.type(typeId);
+        uint32_t columns = 1;
+        uint32_t columnType = typeId;
+        if ((t[0] & 0xFFFF) == OpTypeMatrix) {
+          columns = t[3];
+          columnType = t[2];
+        }
+        for (uint32_t column = 0; column < columns; column++) {
+          VkeShaderInput input{};
+          input.location = decorations.location + column;
+          input.format = inputFormat(module, columnType, input.size);
+          input.name = module.name(variable.id);
+          reflection.inputs_.push_back(input);
+        }
+        break;
+      }
+
+      case StorageClassPushConstant: {
+        const auto &t = module.type(typeId);
+        for (uint32_t member = 0; member + 2 < t.size(); member++) {
+          MemberDecorations md = module.memberDecorations(typeId, member);
+          pushBegin = std::min(pushBegin, md.offset);
+          pushEnd = std::max(pushEnd, md.offset + module.sizeOf(t[member + 2], md.matrixStride));
+        }
+        break;
+      }
+
+      case StorageClassUniform:
+      case StorageClassUniformConstant:
+      case StorageClassStorageBuffer: {
+        if (decorations.binding == UINT32_MAX) {
+          break;
+        }
+        uint32_t count = 1;
+        const auto *t = &module.type(typeId);
+        if (((*t)[0] & 0xFFFF) == OpTypeArray) {
+          count = module.constant((*t)[3]);
+          typeId = (*t)[2];
+        } else if (((*t)[0] & 0xFFFF) == OpTypeRuntimeArray) {
+          typeId = (*t)[2];  // bindless arrays need descriptor indexing, reflected as a single descriptor
+        }
+
+        bool supported = false;
+        VkDescriptorType type = descriptorType(module, variable.storageClass, typeId, supported);
+        if (!supported) {
+          break;
+        }
+
+        VkeDescriptorBinding binding{};
+        binding.set = decorations.set == UINT32_MAX ? 0 : decorations.set;
+        binding.binding = decorations.binding;
+        binding.type = type;
+        binding.count = count;
+        binding.stages = reflection.stage_;
+        binding.name = module.name(variable.id);
+        if (binding.name.empty()) {
+          binding.name = module.name(typeId);  // nameless uniform blocks: use the block's type name
+        }
+        reflection.bindings_.push_back(binding);
+        break;
+      }
+
+      default:
+        break;
+    }
+  }
+
+  if (reflection.stage_ == VK_SHADER_STAGE_COMPUTE_BIT) {
+    reflectLocalSize(module, reflection.localSize_, reflection.localSizeSpecIds_);
+  }
+
+  if (pushEnd > 0) {
+    // ranges are in multiples of 4 bytes
+    pushBegin &= ~3u;
+    pushEnd = (pushEnd + 3) & ~3u;
+    reflection.pushConstants_.stageFlags = reflection.stage_;
+    reflection.pushConstants_.offset = pushBegin;
+    reflection.pushConstants_.size = pushEnd - pushBegin;
+  }
+
+  std::sort(
+      reflection.inputs_.begin(),
+      reflection.inputs_.end(),
+      [](const VkeShaderInput &a, const VkeShaderInput &b) { return a.location < b.location; });
+  std::sort(
+      reflection.bindings_.begin(),
+      reflection.bindings_.end(),
+      [](const VkeDescriptorBinding &a, const VkeDescriptorBinding &b) {
+        return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+      });
+  return reflection;
+}
+
+void VkeShaderReflection::compactVertexInput(
+    std::vector<VkVertexInputBindingDescription> &bindingDescriptions,
+    std::vector<VkVertexInputAttributeDescription> &attributeDescriptions) const {
+  std::vector<VkVertexInputAttributeDescription> used;
+  for (const VkeShaderInput &input : inputs_) {
+    auto it = std::find_if(
+        attributeDescriptions.begin(),
+        attributeDescriptions.end(),
+        [&](const VkVertexInputAttributeDescription &a) { return a.location == input.location; });
+    if (it == attributeDescriptions.end()) {
+      throw std::runtime_error(
+          "vertex shader reads location " + std::to_string(input.location) + " (" + input.name +
+          ") which the vertex layout doesn't provide");
+    }
+    used.push_back(*it);
+  }
+  attributeDescriptions = std::move(used);
+
+  bindingDescriptions.erase(
+      std::remove_if(
+          bindingDescriptions.begin(),
+          bindingDescriptions.end(),
+          [&](const VkVertexInputBindingDescription &b) {
+            return std::none_of(
+                attributeDescriptions.begin(),
+                attributeDescriptions.end(),
+                [&](const VkVertexInputAttributeDescription &a) { return a.binding == b.binding; });
+          }),
+      bindingDescriptions.end());
+}
+
+void VkeShaderReflection::packedVertexInput(
+    uint32_t binding,
+    std::vector<VkVertexInputBindingDescription> &bindingDescriptions,
+    std::vector<VkVertexInputAttributeDescription> &attributeDescriptions) const {
+  bindingDescriptions.clear();
+  attributeDescriptions.clear();
+
+  uint32_t offset = 0;
+  for (const VkeShaderInput &input : inputs_) {
+    if (input.format == VK_FORMAT_UNDEFINED) {
+      throw std::runtime_error(
+          "vertex input " + input.name + " has a type a vertex buffer can't feed");
+    }
+    attributeDescriptions.push_back({input.location, binding, input.format, offset});
+    offset += input.size;
+  }
+  if (offset > 0) {
+    bindingDescriptions.push_back({binding, offset, VK_VERTEX_INPUT_RATE_VERTEX});
+  }
+}
+
+VkePipelineLayoutDescription VkePipelineLayoutDescription::merge(
+    std::initializer_list<const VkeShaderReflection *> stages) {
+  VkePipelineLayoutDescription description{};
+  VkPushConstantRange push{};
+  uint32_t pushEnd = 0;
+
+  for (const VkeShaderReflection *stage : stages) {
+    for (const VkeDescriptorBinding &binding : stage->descriptorBindings()) {
+      if (description.sets.size() <= binding.set) {
+        description.sets.resize(binding.set + 1);
+      }
+      auto &set = description.sets[binding.set];
+      auto it = std::find_if(set.begin(), set.end(), [&](const VkDescriptorSetLayoutBinding &b) {
+        return b.binding == binding.binding;
+      });
+      if (it == set.end()) {
+        VkDescriptorSetLayoutBinding layoutBinding{};
+        layoutBinding.binding = binding.binding;
+        layoutBinding.descriptorType = binding.type;
+        layoutBinding.descriptorCount = binding.count;
+        layoutBinding.stageFlags = binding.stages;
+        set.push_back(layoutBinding);
+      } else if (it->descriptorType != binding.type || it->descriptorCount != binding.count) {
+        throw std::runtime_error(
+            "stages disagree on set " + std::to_string(binding.set) + " binding " +
+            std::to_string(binding.binding) + " (" + binding.name + ")");
+      } else {
+        it->stageFlags |= binding.stages;
+      }
+    }
+
+    VkPushConstantRange range = stage->pushConstantRange();
+    if (range.size > 0) {
+      if (push.size == 0) {
+        push.offset = range.offset;
+      }
+      push.offset = std::min(push.offset, range.offset);
+      pushEnd = std::max(pushEnd, range.offset + range.size);
+      push.size = pushEnd - push.offset;
+      push.stageFlags |= range.stageFlags;
+    }
+  }
+
+  for (auto &set : description.sets) {
+    std::sort(set.begin(), set.end(), [](const auto &a, const auto &b) {
+      return a.binding < b.binding;
+    });
+  }
+  if (push.size > 0) {
+    description.pushConstantRanges.push_back(push);
+  }
+  return description;
+}
+
+std::vector<uint32_t> VkePipelineLayoutDescription::setKey(
+    const std::vector<VkDescriptorSetLayoutBinding> &bindings) {
+  std::vector<uint32_t> words;
+  words.reserve(1 + bindings.size() * 4);
+  words.push_back(static_cast<uint32_t>(bindings.size()));
+  for (const auto &b : bindings) {
+    words.push_back(b.binding);
+    words.push_back(static_cast<uint32_t>(b.descriptorType));
+    words.push_back(b.descriptorCount);
+    words.push_back(b.stageFlags);
+  }
+  return words;
+}
+
+std::vector<uint32_t> VkePipelineLayoutDescription::key() const {
+  std::vector<uint32_t> words;
+  words.push_back(static_cast<uint32_t>(sets.size()));
+  for (const auto &set : sets) {
+    std::vector<uint32_t> setWords = setKey(set);
+    words.insert(words.end(), setWords.begin(), setWords.end());
+  }
+  words.push_back(static_cast<uint32_t>(pushConstantRanges.size()));
+  for (const auto &range : pushConstantRanges) {
+    words.push_back(range.stageFlags);
+    words.push_back(range.offset);
+    words.push_back(range.size);
+  }
+  return words;
+}
+
+}  // namespace vke
@@ -0,0 +1,91 @@
+#pragma once
+
+// vulkan headers
+#include <vulkan/vulkan.h>
+
+// std lib headers
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+namespace vke {
+
+// A stage input with a Location decoration (built-ins like gl_VertexIndex are not listed)
+struct VkeShaderInput {
+  uint32_t location;
+  VkFormat format;  // the shader's own type, e.g. vec2 -> R32G32_SFLOAT
+  uint32_t size;    // bytes of one element of that format
+  std::string name;
+};
+
+struct VkeDescriptorBinding {
+  uint32_t set;
+  uint32_t binding;
+  VkDescriptorType type;
+  uint32_t count;  // array size, 1 for runtime sized arrays
+  VkShaderStageFlags stages;
+  std::string name;
+};
+
+// What one SPIR-V module declares: its stage, located inputs, descriptor bindings and push constant
+// block. Parsed straight from the binary (no spirv-reflect dependency), covering what GLSL -> SPIR-V
+// compilers emit for graphics and compute shaders; unknown instructions are skipped.
+class VkeShaderReflection {
+ public:
+  // throws std::runtime_error on a malformed binary or a module without entry point
+  static VkeShaderReflection reflect(const uint32_t *code, size_t wordCount);
+
+  VkShaderStageFlagBits stage() const { return stage_; }
+  // sorted by location
+  const std::vector<VkeShaderInput> &inputs() const { return inputs_; }
+  // sorted by (set, binding)
+  const std::vector<VkeDescriptorBinding> &descriptorBindings() const { return bindings_; }
+  // covering range of the push constant block, size 0 when there is none
+  VkPushConstantRange pushConstantRange() const { return pushConstants_; }
+  // Compute stage: workgroup size (local_size_x/y/z), {1, 1, 1} for other stages. A dimension set
+  // with local_size_x_id holds the constant's default, its constant_id is in localSizeSpecIds
+  const uint32_t *localSize() const { return localSize_; }
+  // UINT32_MAX for dimensions that aren't specialization constants
+  const uint32_t *localSizeSpecIds() const { return localSizeSpecIds_; }
+
+  // Vertex stage: drops the attributes (and bindings left without attributes) the shader never
+  // reads, strides and offsets stay as they are so the buffers don't change. Throws if the shader
+  // reads a location the descriptions don't provide.
+  void compactVertexInput(
+      std::vector<VkVertexInputBindingDescription> &bindingDescriptions,
+      std::vector<VkVertexInputAttributeDescription> &attributeDescriptions) const;
+
+  // Vertex stage: one tightly packed binding holding every input in the shader's own format
+  void packedVertexInput(
+      uint32_t binding,
+      std::vector<VkVertexInputBindingDescription> &bindingDescriptions,
+      std::vector<VkVertexInputAttributeDescription> &attributeDescriptions) const;
+
+ private:
+  VkShaderStageFlagBits stage_ = VK_SHADER_STAGE_VERTEX_BIT;
+  std::vector<VkeShaderInput> inputs_;
+  std::vector<VkeDescriptorBinding> bindings_;
+  VkPushConstantRange pushConstants_{};
+  uint32_t localSize_[3] = {1, 1, 1};
+  uint32_t localSizeSpecIds_[3] = {UINT32_MAX, UINT32_MAX, UINT32_MAX};
+};
+
+// Pipeline layout of a set of stages: bindings that appear in several stages are merged (stage flags
+// or'ed), push constants become one range covering every stage's block. Set numbers nobody uses in
+// between used ones become empty set layouts, as Vulkan wants sets to be contiguous.
+struct VkePipelineLayoutDescription {
+  std::vector<std::vector<VkDescriptorSetLayoutBinding>> sets;  // index = set number
+  std::vector<VkPushConstantRange> pushConstantRanges;
+
+  // throws if two stages disagree on a binding's type or count
+  static VkePipelineLayoutDescription merge(
+      std::initializer_list<const VkeShaderReflection *> stages);
+
+  // words describing one set layout / the whole layout, for hashing and equality
+  static std::vector<uint32_t> setKey(const std::vector<VkDescriptorSetLayoutBinding> &bindings);
+  std::vector<uint32_t> key() const;
+};
+
+}  // namespace vke
@@ -1,6 +1,7 @@
 #include "vke_swap_chain.hpp"
 
 // std
+#include <algorithm>
 #include <array>
 #include <cstdlib>
 #include <cstring>
@@ -12,9 +13,26 @@
 // DONT UNDERSTAND SWAP CHAIN FILES JUST YET. Will get to soon enough.
 namespace vke {
 
-VkeSwapChain::VkeSwapChain(VkDerkDevice &deviceRef, VkExtent2D extent)
-    : device{deviceRef}, windowExtent{extent} {
-  createSwapChain();
+namespace {
+
+size_t framesInFlightFor(VkePresentPolicy policy) {
+  switch (policy) {
+    case VkePresentPolicy::LowLatency: return 1;
+    case VkePresentPolicy::MaxThroughput: return 3;
+    case VkePresentPolicy::Balanced:
+    default: return 2;
+  }
+}
+
+}  // namespace
+
+VkeSwapChain::VkeSwapChain(VkDerkDevice &deviceRef, VkExtent2D extent, VkePresentPolicy policy)
+    : device{deviceRef},
+      windowExtent{extent},
+      presentPolicy_{policy},
+      framesInFlight_{framesInFlightFor(policy)} {
+  static_assert(MAX_FRAMES_IN_FLIGHT >= 3, "MaxThroughput needs 3 frames in flight");
+  createSwapChain(VK_NULL_HANDLE);
   createImageViews();
   createRenderPass();
   createDepthResources();
@@ -33,11 +51,10 @@ VkeSwapChain::~VkeSwapChain() {
     swapChain = nullptr;
   }
 
-  for (int i = 0; i < depthImages.size(); i++) {
-    vkDestroyImageView(device.device(), depthImageViews[i], nullptr);
-    vkDestroyImage(device.device(), depthImages[i], nullptr);
-    vkFreeMemory(device.device(), depthImageMemorys[i], nullptr);
+  for (auto depthImageView : depthImageViews) {
+    vkDestroyImageView(device.device(), depthImageView, nullptr);
   }
+  device.destroyAliasedImages(depthImages, depthImageMemory);
 
   for (auto framebuffer : swapChainFramebuffers) {
     vkDestroyFramebuffer(device.device(), framebuffer, nullptr);
@@ -49,17 +66,13 @@ VkeSwapChain::~VkeSwapChain() {
   for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
     vkDestroySemaphore(device.device(), renderFinishedSemaphores[i], nullptr);
     vkDestroySemaphore(device.device(), imageAvailableSemaphores[i], nullptr);
-    vkDestroyFence(device.device(), inFlightFences[i], nullptr);
   }
 }
 
 VkResult VkeSwapChain::acquireNextImage(uint32_t *imageIndex) {
-  vkWaitForFences(
-      device.device(),
-      1,
-      &inFlightFences[currentFrame],
-      VK_TRUE,
-      std::numeric_limits<uint64_t>::max());
+  device.graphicsTimeline().wait(frameValues[currentFrame]);
+  // this slot's previous frame is done, so is everything submitted before it
+  device.deletionQueue().collect();
 
   VkResult result = vkAcquireNextImageKHR(
       device.device(),
@@ -73,33 +86,23 @@ VkResult VkeSwapChain::acquireNextImage(uint32_t *imageIndex) {
 }
 
 VkResult VkeSwapChain::submitCommandBuffers(
-    const VkCommandBuffer *buffers, uint32_t *imageIndex) {
-  if (imagesInFlight[*imageIndex] != VK_NULL_HANDLE) {
-    vkWaitForFences(device.device(), 1, &imagesInFlight[*imageIndex], VK_TRUE, UINT64_MAX);
-  }
-  imagesInFlight[*imageIndex] = inFlightFences[currentFrame];
-
-  VkSubmitInfo submitInfo = {};
-  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-
-  VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame]};
-  VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-  submitInfo.waitSemaphoreCount = 1;
-  submitInfo.pWaitSemaphores = waitSemaphores;
-  submitInfo.pWaitDstStageMask = waitStages;
-
-  submitInfo.commandBufferCount = 1;
-  submitInfo.pCommandBuffers = buffers;
+    const VkCommandBuffer *buffers,
+    uint32_t *imageIndex,
+    const std::vector<VkeSemaphoreWait> &extraWaits) {
+  // an image acquired out of order may still be rendered to by an older slot's frame
+  VkeTimeline &timeline = device.graphicsTimeline();
+  timeline.wait(imageValues[*imageIndex]);
+
+  // acquire and present still go through binary semaphores, WSI takes nothing else
+  std::vector<VkeSemaphoreWait> waits{
+      {imageAvailableSemaphores[currentFrame], 0, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT}};
+  waits.insert(waits.end(), extraWaits.begin(), extraWaits.end());
 
   VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame]};
-  submitInfo.signalSemaphoreCount = 1;
-  submitInfo.pSignalSemaphores = signalSemaphores;
-
-  vkResetFences(device.device(), 1, &inFlightFences[currentFrame]);
-  if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, inFlightFences[currentFrame]) !=
-      VK_SUCCESS) {
-    throw std::runtime_error("failed to submit draw command buffer!");
-  }
+  uint64_t value =
+      timeline.submit(device.graphicsQueue(), 1, buffers, waits, {signalSemaphores[0]});
+  frameValues[currentFrame] = value;
+  imageValues[*imageIndex] = value;
 
   VkPresentInfoKHR presentInfo = {};
   presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -115,23 +118,106 @@ VkResult VkeSwapChain::submitCommandBuffers(
 
   auto result = vkQueuePresentKHR(device.presentQueue(), &presentInfo);
 
-  currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+  currentFrame = (currentFrame + 1) % framesInFlight_;
 
   return result;
 }
 
-void VkeSwapChain::createSwapChain() {
+void VkeSwapChain::recreate(VkExtent2D extent) {
+  windowExtent = extent;
+  VkFormat previousFormat = swapChainImageFormat;
+
+  // the new chain is created from the old one (still valid, just retired), which lets the
+  // presentation engine hand over without a blank frame
+  VkSwapchainKHR oldSwapChain = swapChain;
+  createSwapChain(oldSwapChain);
+  retireSizeDependentResources(oldSwapChain);
+
+  if (swapChainImageFormat != previousFormat) {
+    throw std::runtime_error("swap chain image format changed, the render pass no longer matches!");
+  }
+
+  createImageViews();
+  createDepthResources();
+  createFramebuffers();
+  // the new images have never been rendered to; frames in flight keep their own timeline values
+  imageValues.assign(imageCount(), 0);
+}
+
+void VkeSwapChain::setPresentPolicy(VkePresentPolicy policy) {
+  presentPolicy_ = policy;
+  // slots that fall out of use keep their last frame's timeline value, acquireNextImage waits on
+  // whichever slot comes next, so shrinking needs no wait here
+  framesInFlight_ = framesInFlightFor(policy);
+  if (currentFrame >= framesInFlight_) {
+    currentFrame = 0;
+  }
+  recreate(windowExtent);
+}
+
+const char *VkeSwapChain::presentPolicyName(VkePresentPolicy policy) {
+  switch (policy) {
+    case VkePresentPolicy::LowLatency: return "low-latency";
+    case VkePresentPolicy::MaxThroughput: return "max-throughput";
+    case VkePresentPolicy::Balanced:
+    default: return "balanced";
+  }
+}
+
+bool VkeSwapChain::parsePresentPolicy(const std::string &name, VkePresentPolicy &policy) {
+  for (VkePresentPolicy candidate :
+       {VkePresentPolicy::LowLatency, VkePresentPolicy::Balanced, VkePresentPolicy::MaxThroughput}) {
+    if (name == presentPolicyName(candidate)) {
+      policy = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+void VkeSwapChain::retireSizeDependentResources(VkSwapchainKHR oldSwapChain) {
+  std::vector<VkImageView> imageViews;
+  std::vector<VkFramebuffer> framebuffers;
+  std::vector<VkImageView> depthViews;
+  std::vector<VkImage> depth;
+  imageViews.swap(swapChainImageViews);
+  framebuffers.swap(swapChainFramebuffers);
+  depthViews.swap(depthImageViews);
+  depth.swap(depthImages);
+  VkeAllocation depthMemory = depthImageMemory;
+  depthImageMemory = {};
+
+  // frames still in flight render into these, so they go once every frame submitted so far is done
+  VkDerkDevice &device = this->device;
+  device.deletionQueue().push([&device,
+                               oldSwapChain,
+                               imageViews,
+                               framebuffers,
+                               depthViews,
+                               depth,
+                               depthMemory]() mutable {
+    for (auto framebuffer : framebuffers) {
+      vkDestroyFramebuffer(device.device(), framebuffer, nullptr);
+    }
+    for (auto depthImageView : depthViews) {
+      vkDestroyImageView(device.device(), depthImageView, nullptr);
+    }
+    device.destroyAliasedImages(depth, depthMemory);
+    for (auto imageView : imageViews) {
+      vkDestroyImageView(device.device(), imageView, nullptr);
+    }
+    vkDestroySwapchainKHR(device.device(), oldSwapChain, nullptr);
+  });
+}
+
+void VkeSwapChain::createSwapChain(VkSwapchainKHR oldSwapChain) {
   SwapChainSupportDetails swapChainSupport = device.getSwapChainSupport();
 
   VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
   VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
   VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
 
-  uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
-  if (swapChainSupport.capabilities.maxImageCount > 0 &&
-      imageCount > swapChainSupport.capabilities.maxImageCount) {
-    imageCount = swapChainSupport.capabilities.maxImageCount;
-  }
+  uint32_t imageCount = chooseImageCount(swapChainSupport.capabilities);
 
   VkSwapchainCreateInfoKHR createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
@@ -161,9 +247,10 @@ void VkeSwapChain::createSwapChain() {
   createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
 
   createInfo.presentMode = presentMode;
+  presentMode_ = presentMode;
   createInfo.clipped = VK_TRUE;
 
-  createInfo.oldSwapchain = VK_NULL_HANDLE;
+  createInfo.oldSwapchain = oldSwapChain;
 
   if (vkCreateSwapchainKHR(device.device(), &createInfo, nullptr, &swapChain) != VK_SUCCESS) {
     throw std::runtime_error("failed to create swap chain!");
@@ -246,6 +333,20 @@ void VkeSwapChain::createRenderPass() {
   dependency.srcAccessMask = 0;
   dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 
+  // Depth images alias one allocation: the previous frame's depth writes have to finish before
+  // this pass clears and writes depth again.
+  VkSubpassDependency depthDependency = {};
+  depthDependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+  depthDependency.dstSubpass = 0;
+  depthDependency.srcStageMask =
+      VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+  depthDependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  depthDependency.dstStageMask =
+      VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+  depthDependency.dstAccessMask =
+      VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+  std::array<VkSubpassDependency, 2> dependencies = {dependency, depthDependency};
   std::array<VkAttachmentDescription, 2> attachments = {colorAttachment, depthAttachment};
   VkRenderPassCreateInfo renderPassInfo = {};
   renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
@@ -253,8 +354,8 @@ void VkeSwapChain::createRenderPass() {
   renderPassInfo.pAttachments = attachments.data();
   renderPassInfo.subpassCount = 1;
   renderPassInfo.pSubpasses = &subpass;
-  renderPassInfo.dependencyCount = 1;
-  renderPassInfo.pDependencies = &dependency;
+  renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+  renderPassInfo.pDependencies = dependencies.data();
 
   if (vkCreateRenderPass(device.device(), &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
     throw std::runtime_error("failed to create render pass!");
@@ -290,33 +391,50 @@ void VkeSwapChain::createDepthResources() {
   VkFormat depthFormat = findDepthFormat();
   VkExtent2D swapChainExtent = getSwapChainExtent();
 
-  depthImages.resize(imageCount());
-  depthImageMemorys.resize(imageCount());
-  depthImageViews.resize(imageCount());
+  // Depth is cleared on load and never stored, so it never has to exist outside the render pass:
+  // TRANSIENT lets tilers keep it in tile memory, and LAZILY_ALLOCATED memory (where the device
+  // has it) is then barely committed at all. Elsewhere every framebuffer aliases one allocation,
+  // the render pass's depth dependency keeps consecutive frames from overlapping on it.
+  VkImageCreateInfo imageInfo{};
+  imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  imageInfo.imageType = VK_IMAGE_TYPE_2D;
+  imageInfo.extent.width = swapChainExtent.width;
+  imageInfo.extent.height = swapChainExtent.height;
+  imageInfo.extent.depth = 1;
+  imageInfo.mipLevels = 1;
+  imageInfo.arrayLayers = 1;
+  imageInfo.format = depthFormat;
+  imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  imageInfo.usage =
+      VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+  imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  imageInfo.flags = 0;
+
+  // probe which memory types a transient depth image accepts
+  VkImage probe;
+  if (vkCreateImage(device.device(), &imageInfo, nullptr, &probe) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create image!");
+  }
+  VkMemoryRequirements memRequirements;
+  vkGetImageMemoryRequirements(device.device(), probe, &memRequirements);
+  vkDestroyImage(device.device(), probe, nullptr);
+
+  VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+  if (device.supportsLazilyAllocatedMemory(memRequirements.memoryTypeBits)) {
+    properties |= VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+  }
 
-  for (int i = 0; i < depthImages.size(); i++) {
-    VkImageCreateInfo imageInfo{};
-    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-    imageInfo.imageType = VK_IMAGE_TYPE_2D;
-    imageInfo.extent.width = swapChainExtent.width;
-    imageInfo.extent.height = swapChainExtent.height;
-    imageInfo.extent.depth = 1;
-    imageInfo.mipLevels = 1;
-    imageInfo.arrayLayers = 1;
-    imageInfo.format = depthFormat;
-    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
-    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    imageInfo.flags = 0;
-
-    device.createImageWithInfo(
-        imageInfo,
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-        depthImages[i],
-        depthImageMemorys[i]);
+  device.createAliasedImages(
+      imageInfo,
+      static_cast<uint32_t>(imageCount()),
+      properties,
+      depthImages,
+      depthImageMemory);
 
+  depthImageViews.resize(imageCount());
+  for (size_t i = 0; i < depthImages.size(); i++) {
     VkImageViewCreateInfo viewInfo{};
     viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
     viewInfo.image = depthImages[i];
@@ -337,22 +455,17 @@ void VkeSwapChain::createDepthResources() {
 void VkeSwapChain::createSyncObjects() {
   imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
   renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-  inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-  imagesInFlight.resize(imageCount(), VK_NULL_HANDLE);
+  frameValues.assign(MAX_FRAMES_IN_FLIGHT, 0);
+  imageValues.assign(imageCount(), 0);
 
   VkSemaphoreCreateInfo semaphoreInfo = {};
   semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-  VkFenceCreateInfo fenceInfo = {};
-  fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-  fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
   for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
     if (vkCreateSemaphore(device.device(), &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) !=
             VK_SUCCESS ||
         vkCreateSemaphore(device.device(), &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) !=
-            VK_SUCCESS ||
-        vkCreateFence(device.device(), &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS) {
+            VK_SUCCESS) {
       throw std::runtime_error("failed to create synchronization objects for a frame!");
     }
   }
@@ -371,29 +484,60 @@ VkSurfaceFormatKHR VkeSwapChain::chooseSwapSurfaceFormat(
 }
 
 // Swapchain Present Mode: FIFO (Vsync) is only guaranteed support. Rest must be checked for availability.
+// The present policy orders the candidates, the first one the surface offers wins.
 VkPresentModeKHR VkeSwapChain::chooseSwapPresentMode(
     const std::vector<VkPresentModeKHR> &availablePresentModes) {
+  std::vector<VkPresentModeKHR> preferred;
+  switch (presentPolicy_) {
+    case VkePresentPolicy::LowLatency:
+      // vsync'd without a queue of stale frames: shows the newest finished image each refresh
+#ifdef VK_EXT_present_mode_fifo_latest_ready
+      if (device.presentModeFifoLatestReadySupported()) {
+        preferred.push_back(VK_PRESENT_MODE_FIFO_LATEST_READY_EXT);
+      }
+#endif
+      preferred.push_back(VK_PRESENT_MODE_MAILBOX_KHR);
+      break;
+    case VkePresentPolicy::MaxThroughput:
+      // Immediate may tear, mailbox is the tear free runner up (power hungry, not good for mobile)
+      preferred = {VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR};
+      break;
+    case VkePresentPolicy::Balanced:
+    default:
+      preferred = {VK_PRESENT_MODE_MAILBOX_KHR};
+      break;
+  }
 
-  // Mailbox present mode better fps but power hungry. Not good for mobile.
-   
-  for (const auto &availablePresentMode : availablePresentModes) {
-    if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
-      std::cout << "Present mode: Mailbox" << std::endl;
-      return availablePresentMode;
+  for (VkPresentModeKHR mode : preferred) {
+    if (std::find(availablePresentModes.begin(), availablePresentModes.end(), mode) !=
+        availablePresentModes.end()) {
+      std::cout << "Present mode: " << (mode == VK_PRESENT_MODE_IMMEDIATE_KHR ? "Immediate"
+                                        : mode == VK_PRESENT_MODE_MAILBOX_KHR ? "Mailbox"
+                                                                              : "FIFO latest ready")
+                << " (" << presentPolicyName(presentPolicy_) << ", " << framesInFlight_
+                << " frames in flight)" << std::endl;
+      return mode;
     }
   }
 
-   //for (const auto &availablePresentMode : availablePresentModes) {
-   //  if (availablePresentMode == VK_PRESENT_MODE_IMMEDIATE_KHR) {
-   //    std::cout << "Present mode: Immediate" << std::endl;
-   //    return availablePresentMode;
-   //  }
-   //}
-
-  std::cout << "Present mode: V-Sync" << std::endl;
+  std::cout << "Present mode: V-Sync (" << presentPolicyName(presentPolicy_) << ", "
+            << framesInFlight_ << " frames in flight)" << std::endl;
   return VK_PRESENT_MODE_FIFO_KHR;
 }
 
+// The surface's minimum plus a spare so acquiring rarely waits on the image being scanned out, and
+// one more for max throughput so each of its three frames in flight can hold an image
+uint32_t VkeSwapChain::chooseImageCount(const VkSurfaceCapabilitiesKHR &capabilities) {
+  uint32_t imageCount = capabilities.minImageCount + 1;
+  if (presentPolicy_ == VkePresentPolicy::MaxThroughput) {
+    imageCount++;
+  }
+  if (capabilities.maxImageCount > 0 && imageCount > capabilities.maxImageCount) {
+    imageCount = capabilities.maxImageCount;
+  }
+  return imageCount;
+}
+
 VkExtent2D VkeSwapChain::chooseSwapExtent(const VkSurfaceCapabilitiesKHR &capabilities) {
   if (capabilities.currentExtent.width != std::numeric_limits<uint32_t>::max()) {
     return capabilities.currentExtent;
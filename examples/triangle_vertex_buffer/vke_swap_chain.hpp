@@ -1,6 +1,7 @@
 #pragma once
 
 #include "vk_derk_device.hpp"
+#include "vke_render_target.hpp"
 
 // vulkan headers
 #include <vulkan/vulkan.h>
@@ -12,35 +13,71 @@
 // DONT UNDERSTAND SWAP CHAIN FILES JUST YET. Will get to soon enough.
 namespace vke {
 
-class VkeSwapChain {
- public:
-  static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
+// Input latency vs GPU utilization, picked at startup and switchable live (VkeSwapChain::setPresentPolicy)
+//   LowLatency:    1 frame in flight, FIFO_LATEST_READY or MAILBOX. Input shows up soonest, CPU and GPU take turns
+//   Balanced:      2 frames in flight, MAILBOX or FIFO
+//   MaxThroughput: 3 frames in flight plus a spare image, IMMEDIATE. Nobody waits on vsync, may tear
+// Modes the surface doesn't offer fall back down the list, FIFO always exists.
+enum class VkePresentPolicy { LowLatency, Balanced, MaxThroughput };
 
-  VkeSwapChain(VkDerkDevice &deviceRef, VkExtent2D windowExtent);
-  ~VkeSwapChain();
+// Window render target: MAX_FRAMES_IN_FLIGHT is capacity, the present policy decides how many
+// frames are in use
+class VkeSwapChain : public VkeRenderTarget {
+ public:
+  VkeSwapChain(
+      VkDerkDevice &deviceRef,
+      VkExtent2D windowExtent,
+      VkePresentPolicy presentPolicy = VkePresentPolicy::Balanced);
+  ~VkeSwapChain() override;
 
   VkeSwapChain(const VkeSwapChain &) = delete;
   void operator=(const VkeSwapChain &) = delete;
 
-  VkFramebuffer getFrameBuffer(int index) { return swapChainFramebuffers[index]; }
-  VkRenderPass getRenderPass() { return renderPass; }
+  VkFramebuffer getFrameBuffer(int index) override { return swapChainFramebuffers[index]; }
+  VkRenderPass getRenderPass() override { return renderPass; }
   VkImageView getImageView(int index) { return swapChainImageViews[index]; }
   size_t imageCount() { return swapChainImages.size(); }
   VkFormat getSwapChainImageFormat() { return swapChainImageFormat; }
   VkExtent2D getSwapChainExtent() { return swapChainExtent; }
+  VkExtent2D getExtent() override { return swapChainExtent; }
   uint32_t width() { return swapChainExtent.width; }
   uint32_t height() { return swapChainExtent.height; }
+  size_t getCurrentFrame() override { return currentFrame; }
+  size_t framesInFlight() const { return framesInFlight_; }
+  VkePresentPolicy presentPolicy() const { return presentPolicy_; }
+  VkPresentModeKHR presentMode() const { return presentMode_; }
 
   float extentAspectRatio() {
     return static_cast<float>(swapChainExtent.width) / static_cast<float>(swapChainExtent.height);
   }
   VkFormat findDepthFormat();
 
-  VkResult acquireNextImage(uint32_t *imageIndex);
-  VkResult submitCommandBuffers(const VkCommandBuffer *buffers, uint32_t *imageIndex);
+  VkResult acquireNextImage(uint32_t *imageIndex) override;
+  // Submits on the graphics timeline, after the acquired image is available and after extraWaits
+  // (e.g. a transfer timeline value the frame reads from), then presents
+  VkResult submitCommandBuffers(
+      const VkCommandBuffer *buffers,
+      uint32_t *imageIndex,
+      const std::vector<VkeSemaphoreWait> &extraWaits = {}) override;
+
+  // New swap chain for a resized window, handed over from the current one (oldSwapchain) without
+  // waiting for the device. Only size dependent objects are rebuilt: images, depth, framebuffers.
+  // The render pass and frame sync objects stay, so pipelines remain valid. The old objects are
+  // destroyed through the deletion queue once the frames using them have completed. Call it only
+  // between frames: after a present, or after an acquire that returned VK_ERROR_OUT_OF_DATE_KHR.
+  // Throws if the surface format changed, which would need a new render pass.
+  void recreate(VkExtent2D windowExtent);
+  // Changes frames in flight, present mode and image count; recreates the swap chain, so the same
+  // rules as recreate apply
+  void setPresentPolicy(VkePresentPolicy policy);
+
+  static const char *presentPolicyName(VkePresentPolicy policy);
+  // "low-latency", "balanced" or "max-throughput", false for anything else
+  static bool parsePresentPolicy(const std::string &name, VkePresentPolicy &policy);
 
  private:
-  void createSwapChain();
+  void createSwapChain(VkSwapchainKHR oldSwapChain);
+  void retireSizeDependentResources(VkSwapchainKHR oldSwapChain);
   void createImageViews();
   void createDepthResources();
   void createRenderPass();
@@ -53,6 +90,7 @@ class VkeSwapChain {
   VkPresentModeKHR chooseSwapPresentMode(
       const std::vector<VkPresentModeKHR> &availablePresentModes);
   VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR &capabilities);
+  uint32_t chooseImageCount(const VkSurfaceCapabilitiesKHR &capabilities);
 
   VkFormat swapChainImageFormat;
   VkExtent2D swapChainExtent;
@@ -61,7 +99,7 @@ class VkeSwapChain {
   VkRenderPass renderPass;
 
   std::vector<VkImage> depthImages;
-  std::vector<VkDeviceMemory> depthImageMemorys;
+  VkeAllocation depthImageMemory;  // one allocation aliased by every depth image
   std::vector<VkImageView> depthImageViews;
   std::vector<VkImage> swapChainImages;
   std::vector<VkImageView> swapChainImageViews;
@@ -73,9 +111,12 @@ class VkeSwapChain {
 
   std::vector<VkSemaphore> imageAvailableSemaphores;
   std::vector<VkSemaphore> renderFinishedSemaphores;
-  std::vector<VkFence> inFlightFences;
-  std::vector<VkFence> imagesInFlight;
+  std::vector<uint64_t> frameValues;  // graphics timeline value of the frame last submitted per slot
+  std::vector<uint64_t> imageValues;  // ... and of the frame last rendered to each image
   size_t currentFrame = 0;
+  VkePresentPolicy presentPolicy_;
+  size_t framesInFlight_;
+  VkPresentModeKHR presentMode_ = VK_PRESENT_MODE_FIFO_KHR;
 };
 
 }  // namespace lve
@@ -0,0 +1,101 @@
+#include "vke_timeline.hpp"
+
+// std headers
+#include <limits>
+#include <stdexcept>
+
+namespace vke {
+
+VkeTimeline::VkeTimeline(VkDevice device) : device{device} {
+  VkSemaphoreTypeCreateInfo typeInfo{};
+  typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+  typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+  typeInfo.initialValue = 0;
+
+  VkSemaphoreCreateInfo semaphoreInfo{};
+  semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  semaphoreInfo.pNext = &typeInfo;
+
+  if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &semaphore_) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create timeline semaphore!");
+  }
+}
+
+VkeTimeline::~VkeTimeline() { vkDestroySemaphore(device, semaphore_, nullptr); }
+
+uint64_t VkeTimeline::submit(
+    VkQueue queue,
+    uint32_t commandBufferCount,
+    const VkCommandBuffer *commandBuffers,
+    const std::vector<VkeSemaphoreWait> &waits,
+    const std::vector<VkSemaphore> &binarySignals) {
+  std::vector<VkSemaphore> waitSemaphores;
+  std::vector<uint64_t> waitValues;
+  std::vector<VkPipelineStageFlags> waitStages;
+  waitSemaphores.reserve(waits.size());
+  waitValues.reserve(waits.size());
+  waitStages.reserve(waits.size());
+  for (const VkeSemaphoreWait &wait : waits) {
+    waitSemaphores.push_back(wait.semaphore);
+    waitValues.push_back(wait.value);
+    waitStages.push_back(wait.stage);
+  }
+
+  // our own semaphore first, binary ones after it take dummy values
+  std::vector<VkSemaphore> signalSemaphores{semaphore_};
+  signalSemaphores.insert(signalSemaphores.end(), binarySignals.begin(), binarySignals.end());
+  std::vector<uint64_t> signalValues(signalSemaphores.size(), 0);
+
+  std::lock_guard<std::mutex> lock{mutex};
+  signalValues[0] = lastSubmitted_ + 1;
+
+  VkTimelineSemaphoreSubmitInfo timelineInfo{};
+  timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+  timelineInfo.waitSemaphoreValueCount = static_cast<uint32_t>(waitValues.size());
+  timelineInfo.pWaitSemaphoreValues = waitValues.data();
+  timelineInfo.signalSemaphoreValueCount = static_cast<uint32_t>(signalValues.size());
+  timelineInfo.pSignalSemaphoreValues = signalValues.data();
+
+  VkSubmitInfo submitInfo{};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.pNext = &timelineInfo;
+  submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+  submitInfo.pWaitSemaphores = waitSemaphores.data();
+  submitInfo.pWaitDstStageMask = waitStages.data();
+  submitInfo.commandBufferCount = commandBufferCount;
+  submitInfo.pCommandBuffers = commandBuffers;
+  submitInfo.signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size());
+  submitInfo.pSignalSemaphores = signalSemaphores.data();
+
+  if (vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+    throw std::runtime_error("failed to submit command buffer!");
+  }
+  return ++lastSubmitted_;
+}
+
+uint64_t VkeTimeline::lastSubmitted() {
+  std::lock_guard<std::mutex> lock{mutex};
+  return lastSubmitted_;
+}
+
+uint64_t VkeTimeline::completed() {
+  uint64_t value = 0;
+  vkGetSemaphoreCounterValue(device, semaphore_, &value);
+  return value;
+}
+
+void VkeTimeline::wait(uint64_t value) {
+  if (value == 0) {
+    return;  // nothing submitted yet
+  }
+  VkSemaphoreWaitInfo waitInfo{};
+  waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+  waitInfo.semaphoreCount = 1;
+  waitInfo.pSemaphores = &semaphore_;
+  waitInfo.pValues = &value;
+  if (vkWaitSemaphores(device, &waitInfo, std::numeric_limits<uint64_t>::max()) != VK_SUCCESS) {
+    throw std::runtime_error("failed to wait for timeline semaphore!");
+  }
+}
+
+}  // namespace vke
@@ -0,0 +1,67 @@
+#pragma once
+
+// vulkan headers
+#include <vulkan/vulkan.h>
+
+// std lib headers
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace vke {
+
+// One wait of a queue submission. Binary semaphores (swap chain acquire) ignore value.
+struct VkeSemaphoreWait {
+  VkSemaphore semaphore;
+  uint64_t value;
+  VkPipelineStageFlags stage;
+};
+
+// Timeline semaphore (Vulkan 1.2) of one queue: every submission through it signals the next value
+// of a single counter, so "is frame / upload N done" is a comparison against the counter instead of
+// a fence per submission. CPU waits block on a value, and another queue's submission waits on a
+// value as well (waitFor), so transfer, compute and graphics work order against each other without
+// binary semaphores or fence resets.
+//
+// Values follow submission order, submits through one timeline are serialized. Two timelines may
+// share a VkQueue (no dedicated transfer family), as long as they submit from one thread.
+class VkeTimeline {
+ public:
+  explicit VkeTimeline(VkDevice device);
+  ~VkeTimeline();
+
+  VkeTimeline(const VkeTimeline &) = delete;
+  VkeTimeline &operator=(const VkeTimeline &) = delete;
+
+  VkSemaphore semaphore() const { return semaphore_; }
+
+  // One vkQueueSubmit signalling the next value, which it returns. binarySignals are signalled
+  // along with it (render finished semaphores for present).
+  uint64_t submit(
+      VkQueue queue,
+      uint32_t commandBufferCount,
+      const VkCommandBuffer *commandBuffers,
+      const std::vector<VkeSemaphoreWait> &waits = {},
+      const std::vector<VkSemaphore> &binarySignals = {});
+
+  // for another queue's submit: continue at `stage` once this timeline reached value
+  VkeSemaphoreWait waitFor(uint64_t value, VkPipelineStageFlags stage) const {
+    return {semaphore_, value, stage};
+  }
+
+  // value of the latest submit, 0 before the first
+  uint64_t lastSubmitted();
+  // how far the GPU got, never blocks
+  uint64_t completed();
+  bool isComplete(uint64_t value) { return value <= completed(); }
+  // blocks until the GPU reached value, throws std::runtime_error on device loss
+  void wait(uint64_t value);
+
+ private:
+  VkDevice device;
+  VkSemaphore semaphore_;
+  uint64_t lastSubmitted_ = 0;
+  std::mutex mutex;
+};
+
+}  // namespace vke
@@ -0,0 +1,226 @@
+#include "vke_uploader.hpp"
+
+#include "vk_derk_device.hpp"
+
+// std headers
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+namespace vke {
+
+VkeUploader::VkeUploader(VkDerkDevice &device) : device{device} { createCommandPool(); }
+
+VkeUploader::~VkeUploader() {
+  flush();
+  wait(nextTicket - 1);
+
+  vkDestroyCommandPool(device.device(), commandPool, nullptr);
+}
+
+void VkeUploader::createCommandPool() {
+  VkCommandPoolCreateInfo poolInfo = {};
+  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolInfo.queueFamilyIndex = device.findPhysicalQueueFamilies().transferFamily;
+  poolInfo.flags =
+      VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+  if (vkCreateCommandPool(device.device(), &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create upload command pool!");
+  }
+}
+
+VkeUploader::Batch &VkeUploader::openBatch() {
+  if (hasOpenBatch) {
+    return current;
+  }
+
+  current = Batch{};
+  current.ticket = nextTicket++;
+
+  if (!freeCommandBuffers.empty()) {
+    current.commandBuffer = freeCommandBuffers.back();
+    freeCommandBuffers.pop_back();
+  } else {
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandPool = commandPool;
+    allocInfo.commandBufferCount = 1;
+    if (vkAllocateCommandBuffers(device.device(), &allocInfo, &current.commandBuffer) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("failed to allocate upload command buffer!");
+    }
+  }
+
+  VkCommandBufferBeginInfo beginInfo{};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  vkBeginCommandBuffer(current.commandBuffer, &beginInfo);
+
+  hasOpenBatch = true;
+  return current;
+}
+
+VkeUploadTicket VkeUploader::uploadBuffer(
+    const void *data, VkDeviceSize size, VkBuffer dstBuffer, VkDeviceSize dstOffset) {
+  VkBuffer stagingBuffer;
+  VkeAllocation stagingAllocation;
+  device.createBuffer(
+      size,
+      VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+      stagingBuffer,
+      stagingAllocation);
+  memcpy(stagingAllocation.mapped, data, static_cast<size_t>(size));
+
+  std::lock_guard<std::mutex> lock{mutex};
+  Batch &batch = openBatch();
+
+  VkBufferCopy copyRegion{};
+  copyRegion.srcOffset = 0;
+  copyRegion.dstOffset = dstOffset;
+  copyRegion.size = size;
+  vkCmdCopyBuffer(batch.commandBuffer, stagingBuffer, dstBuffer, 1, &copyRegion);
+
+  batch.stagingBuffers.emplace_back(stagingBuffer, stagingAllocation);
+  batch.stagedBytes += size;
+
+  VkeUploadTicket ticket = batch.ticket;
+  if (batch.stagedBytes >= MAX_BATCH_STAGING_BYTES) {
+    submitOpenBatch();
+  }
+  return ticket;
+}
+
+VkeUploadTicket VkeUploader::copyBuffer(
+    VkBuffer srcBuffer,
+    VkBuffer dstBuffer,
+    VkDeviceSize size,
+    VkDeviceSize srcOffset,
+    VkDeviceSize dstOffset) {
+  VkBufferCopy copyRegion{};
+  copyRegion.srcOffset = srcOffset;
+  copyRegion.dstOffset = dstOffset;
+  copyRegion.size = size;
+  return copyBuffer(srcBuffer, dstBuffer, std::vector<VkBufferCopy>{copyRegion});
+}
+
+VkeUploadTicket VkeUploader::copyBuffer(
+    VkBuffer srcBuffer, VkBuffer dstBuffer, const std::vector<VkBufferCopy> &regions) {
+  if (regions.empty()) {
+    return 0;
+  }
+  std::lock_guard<std::mutex> lock{mutex};
+  Batch &batch = openBatch();
+
+  // the source may itself have been filled by an earlier copy on this queue
+  VkMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  vkCmdPipelineBarrier(
+      batch.commandBuffer,
+      VK_PIPELINE_STAGE_TRANSFER_BIT,
+      VK_PIPELINE_STAGE_TRANSFER_BIT,
+      0,
+      1,
+      &barrier,
+      0,
+      nullptr,
+      0,
+      nullptr);
+
+  vkCmdCopyBuffer(
+      batch.commandBuffer,
+      srcBuffer,
+      dstBuffer,
+      static_cast<uint32_t>(regions.size()),
+      regions.data());
+
+  return batch.ticket;
+}
+
+VkeUploadTicket VkeUploader::flush() {
+  std::lock_guard<std::mutex> lock{mutex};
+  if (!hasOpenBatch) {
+    return nextTicket - 1;
+  }
+  return submitOpenBatch();
+}
+
+VkeUploadTicket VkeUploader::submitOpenBatch() {
+  vkEndCommandBuffer(current.commandBuffer);
+
+  // batches open and submit one at a time and nothing else submits on the transfer timeline, so
+  // the value it signals is the batch ticket
+  uint64_t value = device.transferTimeline().submit(device.transferQueue(), 1, &current.commandBuffer);
+  assert(value == current.ticket && "transfer timeline out of step with upload tickets");
+  (void)value;
+
+  VkeUploadTicket ticket = current.ticket;
+  inFlight.push_back(std::move(current));
+  hasOpenBatch = false;
+  return ticket;
+}
+
+// Batches finish in order on one queue, so everything up to the timeline value is done.
+void VkeUploader::retireCompleted(bool block, VkeUploadTicket until) {
+  VkeTimeline &timeline = device.transferTimeline();
+  if (block) {
+    timeline.wait(until);
+  }
+  VkeUploadTicket completed = timeline.completed();
+
+  while (!inFlight.empty()) {
+    Batch &batch = inFlight.front();
+    if (batch.ticket > completed) {
+      break;
+    }
+
+    for (auto &staging : batch.stagingBuffers) {
+      device.destroyBuffer(staging.first, staging.second);
+    }
+    vkResetCommandBuffer(batch.commandBuffer, 0);
+    freeCommandBuffers.push_back(batch.commandBuffer);
+
+    completedTicket = batch.ticket;
+    inFlight.pop_front();
+  }
+}
+
+void VkeUploader::collect() {
+  std::lock_guard<std::mutex> lock{mutex};
+  retireCompleted(false, 0);
+}
+
+bool VkeUploader::isComplete(VkeUploadTicket ticket) {
+  std::lock_guard<std::mutex> lock{mutex};
+  if (ticket <= completedTicket) {
+    return true;
+  }
+  retireCompleted(false, 0);
+  return ticket <= completedTicket;
+}
+
+void VkeUploader::wait(VkeUploadTicket ticket) {
+  std::lock_guard<std::mutex> lock{mutex};
+  if (ticket <= completedTicket) {
+    return;
+  }
+  if (hasOpenBatch && ticket >= current.ticket) {
+    submitOpenBatch();
+  }
+  retireCompleted(true, ticket);
+}
+
+VkeSemaphoreWait VkeUploader::waitFor(VkeUploadTicket ticket, VkPipelineStageFlags stage) {
+  std::lock_guard<std::mutex> lock{mutex};
+  // the GPU wait only resolves once the batch is submitted
+  if (hasOpenBatch && ticket >= current.ticket) {
+    submitOpenBatch();
+  }
+  return device.transferTimeline().waitFor(ticket, stage);
+}
+
+}  // namespace vke
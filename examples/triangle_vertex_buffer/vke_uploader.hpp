@@ -0,0 +1,89 @@
+#pragma once
+
+#include "vke_allocator.hpp"
+#include "vke_timeline.hpp"
+
+// vulkan headers
+#include <vulkan/vulkan.h>
+
+// std lib headers
+#include <deque>
+#include <mutex>
+#include <vector>
+
+namespace vke {
+
+class VkDerkDevice;
+
+// Monotonic id of the batch an upload was recorded into, equal to the transfer timeline value its
+// submission signals. A ticket is done once the timeline has reached it. 0 means "nothing to wait on".
+using VkeUploadTicket = uint64_t;
+
+// Asynchronous upload service. Copies are recorded into an open batch on the transfer queue
+// (graphics queue if the device has no dedicated transfer family), submitted on the device's
+// transfer timeline on flush() and recycled by collect(). Nothing here ever calls vkQueueWaitIdle.
+class VkeUploader {
+ public:
+  // an open batch is flushed automatically once it has staged this many bytes
+  static constexpr VkDeviceSize MAX_BATCH_STAGING_BYTES = 32ull * 1024 * 1024;
+
+  VkeUploader(VkDerkDevice &device);
+  ~VkeUploader();
+
+  VkeUploader(const VkeUploader &) = delete;
+  VkeUploader &operator=(const VkeUploader &) = delete;
+
+  // Copies data into a staging buffer now and records the staging -> dstBuffer copy into the open batch.
+  VkeUploadTicket uploadBuffer(
+      const void *data, VkDeviceSize size, VkBuffer dstBuffer, VkDeviceSize dstOffset = 0);
+  // Records a plain buffer to buffer copy into the open batch.
+  VkeUploadTicket copyBuffer(
+      VkBuffer srcBuffer,
+      VkBuffer dstBuffer,
+      VkDeviceSize size,
+      VkDeviceSize srcOffset = 0,
+      VkDeviceSize dstOffset = 0);
+  // Many regions between the same two buffers behind a single barrier, for batch moves (mesh pool
+  // compaction). Regions must not overlap in dstBuffer. Returns 0 for no regions.
+  VkeUploadTicket copyBuffer(
+      VkBuffer srcBuffer, VkBuffer dstBuffer, const std::vector<VkBufferCopy> &regions);
+
+  // Submits the open batch (no-op if empty) and returns its ticket.
+  VkeUploadTicket flush();
+  // Polls submitted batches and releases the staging buffers of finished ones. Never blocks.
+  void collect();
+
+  bool isComplete(VkeUploadTicket ticket);
+  void wait(VkeUploadTicket ticket);
+  // GPU side wait for another queue's submission (VkeSwapChain::submitCommandBuffers extraWaits):
+  // the frame stalls at `stage` until the upload landed, the CPU never waits. Submits the open
+  // batch if the ticket is in it.
+  VkeSemaphoreWait waitFor(VkeUploadTicket ticket, VkPipelineStageFlags stage);
+
+ private:
+  struct Batch {
+    VkeUploadTicket ticket = 0;
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    VkDeviceSize stagedBytes = 0;
+    std::vector<std::pair<VkBuffer, VkeAllocation>> stagingBuffers;
+  };
+
+  void createCommandPool();
+  Batch &openBatch();
+  VkeUploadTicket submitOpenBatch();
+  void retireCompleted(bool block, VkeUploadTicket until);
+
+  VkDerkDevice &device;
+  VkCommandPool commandPool;
+
+  bool hasOpenBatch = false;
+  Batch current;
+  std::deque<Batch> inFlight;
+  std::vector<VkCommandBuffer> freeCommandBuffers;
+
+  VkeUploadTicket nextTicket = 1;
+  VkeUploadTicket completedTicket = 0;
+  std::mutex mutex;
+};
+
+}  // namespace vke
@@ -0,0 +1,273 @@
+#include "vke_vertex_layout.hpp"
+
+// std headers
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace vke {
+
+namespace {
+
+// IEEE 754 binary16, round to nearest even. Out of range values turn into infinity, which shows up
+// as an infinite error so the quantizer never picks half floats for them.
+uint16_t floatToHalf(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+
+  uint32_t sign = (bits >> 16) & 0x8000u;
+  uint32_t floatExponent = (bits >> 23) & 0xffu;
+  uint32_t mantissa = bits & 0x7fffffu;
+  if (floatExponent == 0xffu) {
+    return static_cast<uint16_t>(sign | 0x7c00u | (mantissa != 0 ? 0x200u : 0u));  // inf / nan
+  }
+
+  int32_t exponent = static_cast<int32_t>(floatExponent) - 127 + 15;
+  if (exponent >= 31) {
+    return static_cast<uint16_t>(sign | 0x7c00u);
+  }
+  if (exponent <= 0) {
+    if (exponent < -10) {
+      return static_cast<uint16_t>(sign);
+    }
+    mantissa |= 0x800000u;  // subnormal half: shift the implicit bit in
+    uint32_t shift = static_cast<uint32_t>(14 - exponent);
+    uint32_t half = mantissa >> shift;
+    uint32_t remainder = mantissa & ((1u << shift) - 1);
+    uint32_t halfway = 1u << (shift - 1);
+    if (remainder > halfway || (remainder == halfway && (half & 1u))) {
+      half++;
+    }
+    return static_cast<uint16_t>(sign | half);
+  }
+
+  uint32_t half = (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+  uint32_t remainder = mantissa & 0x1fffu;
+  if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1u))) {
+    half++;  // a carry into the exponent is still the right answer, up to infinity
+  }
+  return static_cast<uint16_t>(sign | half);
+}
+
+float halfToFloat(uint16_t half) {
+  uint32_t sign = (static_cast<uint32_t>(half) & 0x8000u) << 16;
+  uint32_t exponent = (half >> 10) & 0x1fu;
+  uint32_t mantissa = half & 0x3ffu;
+
+  uint32_t bits;
+  if (exponent == 0) {
+    float value = std::ldexp(static_cast<float>(mantissa), -24);
+    return sign != 0 ? -value : value;
+  } else if (exponent == 31) {
+    bits = sign | 0x7f800000u | (mantissa << 13);
+  } else {
+    bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+  }
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+int16_t toSnorm16(float value) {
+  return static_cast<int16_t>(std::lround(std::min(std::max(value, -1.0f), 1.0f) * 32767.0f));
+}
+
+float fromSnorm16(int16_t value) { return std::max(static_cast<float>(value) / 32767.0f, -1.0f); }
+
+uint8_t toUnorm8(float value) {
+  return static_cast<uint8_t>(std::lround(std::min(std::max(value, 0.0f), 1.0f) * 255.0f));
+}
+
+float fromUnorm8(uint8_t value) { return static_cast<float>(value) / 255.0f; }
+
+float signNotZero(float value) { return value >= 0.0f ? 1.0f : -1.0f; }
+
+// Octahedral mapping: project onto the |x|+|y|+|z| = 1 octahedron and fold the lower half over the
+// upper one, which spreads 2 x 16 bits evenly over the sphere.
+void octEncode(const glm::vec3 &normal, int16_t out[2]) {
+  float sum = std::fabs(normal.x) + std::fabs(normal.y) + std::fabs(normal.z);
+  float x = sum > 0.0f ? normal.x / sum : 0.0f;
+  float y = sum > 0.0f ? normal.y / sum : 0.0f;
+  if (normal.z < 0.0f) {
+    float foldedX = (1.0f - std::fabs(y)) * signNotZero(x);
+    float foldedY = (1.0f - std::fabs(x)) * signNotZero(y);
+    x = foldedX;
+    y = foldedY;
+  }
+  out[0] = toSnorm16(x);
+  out[1] = toSnorm16(y);
+}
+
+glm::vec3 octDecode(const int16_t in[2]) {
+  float x = fromSnorm16(in[0]);
+  float y = fromSnorm16(in[1]);
+  float z = 1.0f - std::fabs(x) - std::fabs(y);
+  float t = std::max(-z, 0.0f);
+  x += x >= 0.0f ? -t : t;
+  y += y >= 0.0f ? -t : t;
+  return glm::vec3(x, y, z);
+}
+
+float angleDegrees(const glm::vec3 &a, const glm::vec3 &b) {
+  float lengthA = std::sqrt(a.x * a.x + a.y * a.y + a.z * a.z);
+  float lengthB = std::sqrt(b.x * b.x + b.y * b.y + b.z * b.z);
+  if (lengthA == 0.0f || lengthB == 0.0f) {
+    return 0.0f;  // degenerate normal, nothing to preserve
+  }
+  float cosine = (a.x * b.x + a.y * b.y + a.z * b.z) / (lengthA * lengthB);
+  return std::acos(std::min(std::max(cosine, -1.0f), 1.0f)) * 57.2957795f;
+}
+
+uint32_t positionSize(VkePositionFormat format) {
+  return format == VkePositionFormat::Float16 ? 4 : 8;
+}
+
+uint32_t normalSize(VkeNormalFormat format) {
+  switch (format) {
+    case VkeNormalFormat::Float32:
+      return 12;
+    case VkeNormalFormat::Snorm16:
+      return 8;
+    case VkeNormalFormat::Octahedral16:
+      return 4;
+    default:
+      return 0;
+  }
+}
+
+uint32_t colorSize(VkeColorFormat format) {
+  switch (format) {
+    case VkeColorFormat::Float32:
+      return 12;
+    case VkeColorFormat::Unorm8:
+      return 4;
+    default:
+      return 0;
+  }
+}
+
+}  // namespace
+
+uint32_t VkeVertexLayout::stride() const {
+  return positionSize(position) + normalSize(normal) + colorSize(color);
+}
+
+std::vector<VkVertexInputBindingDescription> VkeVertexLayout::getBindingDescriptions() const {
+  std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
+  bindingDescriptions[0].binding = 0;
+  bindingDescriptions[0].stride = stride();
+  bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+  return bindingDescriptions;
+}
+
+std::vector<VkVertexInputAttributeDescription> VkeVertexLayout::getAttributeDescriptions() const {
+  std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+  uint32_t offset = 0;
+
+  VkVertexInputAttributeDescription attribute{};
+  attribute.binding = 0;
+  attribute.location = POSITION_LOCATION;
+  attribute.format = position == VkePositionFormat::Float16 ? VK_FORMAT_R16G16_SFLOAT
+                                                            : VK_FORMAT_R32G32_SFLOAT;
+  attribute.offset = offset;
+  attributeDescriptions.push_back(attribute);
+  offset += positionSize(position);
+
+  if (normal != VkeNormalFormat::None) {
+    attribute.location = NORMAL_LOCATION;
+    attribute.format = normal == VkeNormalFormat::Float32   ? VK_FORMAT_R32G32B32_SFLOAT
+                       : normal == VkeNormalFormat::Snorm16 ? VK_FORMAT_R16G16B16A16_SNORM
+                                                            : VK_FORMAT_R16G16_SNORM;
+    attribute.offset = offset;
+    attributeDescriptions.push_back(attribute);
+    offset += normalSize(normal);
+  }
+
+  if (color != VkeColorFormat::None) {
+    attribute.location = COLOR_LOCATION;
+    attribute.format =
+        color == VkeColorFormat::Float32 ? VK_FORMAT_R32G32B32_SFLOAT : VK_FORMAT_R8G8B8A8_UNORM;
+    attribute.offset = offset;
+    attributeDescriptions.push_back(attribute);
+  }
+
+  return attributeDescriptions;
+}
+
+void VkeVertexLayout::encode(
+    const glm::vec2 &positionValue,
+    const glm::vec3 &normalValue,
+    const glm::vec3 &colorValue,
+    uint8_t *dst) const {
+  if (position == VkePositionFormat::Float16) {
+    uint16_t packed[2] = {floatToHalf(positionValue.x), floatToHalf(positionValue.y)};
+    memcpy(dst, packed, sizeof(packed));
+  } else {
+    float packed[2] = {positionValue.x, positionValue.y};
+    memcpy(dst, packed, sizeof(packed));
+  }
+  dst += positionSize(position);
+
+  if (normal == VkeNormalFormat::Float32) {
+    float packed[3] = {normalValue.x, normalValue.y, normalValue.z};
+    memcpy(dst, packed, sizeof(packed));
+  } else if (normal == VkeNormalFormat::Snorm16) {
+    int16_t packed[4] = {
+        toSnorm16(normalValue.x), toSnorm16(normalValue.y), toSnorm16(normalValue.z), 0};
+    memcpy(dst, packed, sizeof(packed));
+  } else if (normal == VkeNormalFormat::Octahedral16) {
+    int16_t packed[2];
+    octEncode(normalValue, packed);
+    memcpy(dst, packed, sizeof(packed));
+  }
+  dst += normalSize(normal);
+
+  if (color == VkeColorFormat::Float32) {
+    float packed[3] = {colorValue.x, colorValue.y, colorValue.z};
+    memcpy(dst, packed, sizeof(packed));
+  } else if (color == VkeColorFormat::Unorm8) {
+    uint8_t packed[4] = {
+        toUnorm8(colorValue.x), toUnorm8(colorValue.y), toUnorm8(colorValue.z), 255};
+    memcpy(dst, packed, sizeof(packed));
+  }
+}
+
+float VkeVertexLayout::positionError(VkePositionFormat format, const glm::vec2 &value) {
+  if (format == VkePositionFormat::Float32) {
+    return 0.0f;
+  }
+  float errorX = std::fabs(halfToFloat(floatToHalf(value.x)) - value.x);
+  float errorY = std::fabs(halfToFloat(floatToHalf(value.y)) - value.y);
+  return std::max(errorX, errorY);
+}
+
+float VkeVertexLayout::normalErrorDegrees(VkeNormalFormat format, const glm::vec3 &value) {
+  switch (format) {
+    case VkeNormalFormat::Snorm16: {
+      glm::vec3 decoded(
+          fromSnorm16(toSnorm16(value.x)),
+          fromSnorm16(toSnorm16(value.y)),
+          fromSnorm16(toSnorm16(value.z)));
+      return angleDegrees(value, decoded);
+    }
+    case VkeNormalFormat::Octahedral16: {
+      int16_t packed[2];
+      octEncode(value, packed);
+      return angleDegrees(value, octDecode(packed));
+    }
+    default:
+      return 0.0f;
+  }
+}
+
+float VkeVertexLayout::colorError(VkeColorFormat format, const glm::vec3 &value) {
+  if (format != VkeColorFormat::Unorm8) {
+    return 0.0f;
+  }
+  float errorR = std::fabs(fromUnorm8(toUnorm8(value.x)) - value.x);
+  float errorG = std::fabs(fromUnorm8(toUnorm8(value.y)) - value.y);
+  float errorB = std::fabs(fromUnorm8(toUnorm8(value.z)) - value.z);
+  return std::max({errorR, errorG, errorB});
+}
+
+}  // namespace vke
@@ -0,0 +1,80 @@
+#pragma once
+
+// vulkan headers
+#include <vulkan/vulkan.h>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std lib headers
+#include <cstdint>
+#include <vector>
+
+namespace vke {
+
+// Per-attribute storage formats, ordered from largest to smallest. Every attribute is padded to 4 bytes.
+enum class VkePositionFormat {
+  Float32,  // R32G32_SFLOAT, 8 bytes
+  Float16,  // R16G16_SFLOAT, 4 bytes
+};
+
+enum class VkeNormalFormat {
+  None,
+  Float32,       // R32G32B32_SFLOAT, 12 bytes
+  Snorm16,       // R16G16B16A16_SNORM, 8 bytes (w unused)
+  Octahedral16,  // R16G16_SNORM, 4 bytes; the vertex shader has to octDecode() it
+};
+
+enum class VkeColorFormat {
+  None,
+  Float32,  // R32G32B32_SFLOAT, 12 bytes
+  Unorm8,   // R8G8B8A8_UNORM, 4 bytes (a = 1)
+};
+
+// Largest error a quantized attribute may introduce. position is in model units (0 keeps float
+// positions), normal is the angle in degrees, color is per channel on a 0..1 scale.
+// allowOctahedral: only for pipelines whose vertex shader octDecode()s the normal, a shader
+// declaring `in vec3 normal` would read R16G16_SNORM data as garbage.
+struct VkeQuantizationBounds {
+  float position = 0.0f;
+  float normalDegrees = 0.5f;
+  float color = 1.0f / 255.0f;
+  bool allowOctahedral = false;
+};
+
+// The vertex stream format the model and the pipeline agree on. Attributes sit at fixed locations
+// (0 position, 1 normal, 2 color) in one interleaved binding; absent attributes take no space and
+// no location.
+struct VkeVertexLayout {
+  VkePositionFormat position = VkePositionFormat::Float32;
+  VkeNormalFormat normal = VkeNormalFormat::None;
+  VkeColorFormat color = VkeColorFormat::None;
+
+  static constexpr uint32_t POSITION_LOCATION = 0;
+  static constexpr uint32_t NORMAL_LOCATION = 1;
+  static constexpr uint32_t COLOR_LOCATION = 2;
+
+  uint32_t stride() const;
+  std::vector<VkVertexInputBindingDescription> getBindingDescriptions() const;
+  std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions() const;
+
+  // writes one vertex (stride() bytes) at dst
+  void encode(
+      const glm::vec2 &positionValue,
+      const glm::vec3 &normalValue,
+      const glm::vec3 &colorValue,
+      uint8_t *dst) const;
+
+  // error the format would introduce for one value, in the units of VkeQuantizationBounds
+  static float positionError(VkePositionFormat format, const glm::vec2 &value);
+  static float normalErrorDegrees(VkeNormalFormat format, const glm::vec3 &value);
+  static float colorError(VkeColorFormat format, const glm::vec3 &value);
+
+  bool operator==(const VkeVertexLayout &other) const {
+    return position == other.position && normal == other.normal && color == other.color;
+  }
+  bool operator!=(const VkeVertexLayout &other) const { return !(*this == other); }
+};
+
+}  // namespace vke
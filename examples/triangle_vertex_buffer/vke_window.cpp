@@ -15,10 +15,27 @@ namespace vke {
 
 		glfwInit();
 		glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);	// glfw base is in context of opengl: tell it not to do that
-		glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);		// disable window resizing after creation
+		glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);		// resizes recreate the swap chain (see VkeSwapChain::recreate)
 
 		// Create window pointer
 		window = glfwCreateWindow(width, height, window_name.c_str(), nullptr, nullptr);
+
+		// Callback gets only the GLFWwindow: point it back at this object
+		glfwSetWindowUserPointer(window, this);
+		glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
+	}
+
+	void VkeWindow::framebufferResizeCallback(GLFWwindow* glfwWindow, int width, int height) {
+		auto vkeWindow = reinterpret_cast<VkeWindow*>(glfwGetWindowUserPointer(glfwWindow));
+		vkeWindow->framebufferResized = true;
+		vkeWindow->width = width;
+		vkeWindow->height = height;
+	}
+
+	void VkeWindow::waitWhileMinimized() {
+		while ((width == 0 || height == 0) && !glfwWindowShouldClose(window)) {
+			glfwWaitEvents();	// the resize callback updates width/height
+		}
 	}
 
 	void VkeWindow::createWindowSurface(VkInstance instance, VkSurfaceKHR* surface) {
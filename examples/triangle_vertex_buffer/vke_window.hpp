@@ -24,15 +24,24 @@ namespace vke {
 			bool shouldClose() { return glfwWindowShouldClose(window); }
 
 			VkExtent2D getExtent() { return { static_cast<uint32_t>(width), static_cast<uint32_t>(height) }; }
+			// Set by the framebuffer size callback, the app recreates its swap chain and clears it
+			bool wasWindowResized() { return framebufferResized; }
+			void resetWindowResizedFlag() { framebufferResized = false; }
+			bool isKeyPressed(int key) { return glfwGetKey(window, key) == GLFW_PRESS; }
+			// Blocks while the window is minimized (0x0 framebuffer, no swap chain can be created for it) unless it gets closed
+			void waitWhileMinimized();
 
 			void createWindowSurface(VkInstance instance, VkSurfaceKHR* surface);
 
 		// Member variable defs
 		private:
 			void initWindow();	// helper fxn
+			static void framebufferResizeCallback(GLFWwindow* window, int width, int height);
 
-			const int width;
-			const int height;
+			// Framebuffer size in pixels, follows resizes
+			int width;
+			int height;
+			bool framebufferResized = false;
 
 			std::string window_name;
 